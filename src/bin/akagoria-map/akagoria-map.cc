@@ -523,18 +523,28 @@ static std::vector<mm::position> generate_river(const mm::heightmap& map, const
   return river;
 }
 
-static std::vector<std::vector<mm::position>> generate_rivers(const mm::heightmap& map, const mm::binarymap& watermap, unsigned rivers_count, double rivers_min_source_altitude, mm::random_engine& engine) {
+static std::vector<std::vector<mm::position>> generate_rivers(const mm::heightmap& map, const mm::binarymap& watermap, unsigned rivers_count, double rivers_min_source_altitude, mm::random_engine& engine, mm::random_mode mode) {
   std::uniform_int_distribution<mm::heightmap::size_type> dist_x(0, map.width() - 1);
   std::uniform_int_distribution<mm::heightmap::size_type> dist_y(0, map.height() - 1);
 
+  // in counter mode, the source of the river i only depends on i
+  mm::counter_random random(mode == mm::random_mode::counter ? engine() : 0);
+
   std::vector<std::vector<mm::position>> rivers;
 
   for (unsigned i = 0; i < rivers_count; ++i) {
     mm::heightmap::size_type x, y;
+    uint32_t attempt = 0;
 
     do {
-      x = dist_x(engine);
-      y = dist_y(engine);
+      if (mode == mm::random_mode::counter) {
+        x = static_cast<mm::heightmap::size_type>(random.uniform(0.0, map.width(), 0, i, attempt, 0));
+        y = static_cast<mm::heightmap::size_type>(random.uniform(0.0, map.height(), 0, i, attempt, 1));
+        attempt++;
+      } else {
+        x = dist_x(engine);
+        y = dist_y(engine);
+      }
     } while (map(x, y) < rivers_min_source_altitude);
 
     auto river = generate_river(map, watermap, {x, y});
@@ -564,18 +574,28 @@ static mm::heightmap compute_humiditymap(const mm::binarymap& watermap) {
 
   mm::binarymap computed(watermap);
 
+  // the queue is processed layer by layer and a layer shares the same
+  // humidity, so the power is only computed when the humidity changes
+  double humidity_cached = -1.0;
+  double humidity_next = 0.0;
+
   while (!queue.empty()) {
     auto here = queue.front();
     assert(computed(here));
 
     double humidity_here = humiditymap(here);
 
-    humiditymap.visit8neighbours(here, [humidity_here, &computed, &queue](mm::position there, double& humidity_there) {
+    if (humidity_here != humidity_cached) {
+      humidity_cached = humidity_here;
+      humidity_next = std::pow(humidity_here, 1.05);
+    }
+
+    humiditymap.visit8neighbours(here, [humidity_next, &computed, &queue](mm::position there, double& humidity_there) {
       if (computed(there)) {
         return;
       }
 
-      humidity_there = std::pow(humidity_here, 1.05);
+      humidity_there = humidity_next;
       computed(there) = true;
       queue.push(there);
     });
@@ -823,6 +843,17 @@ void generate_akagoria_map(YAML::Node node, std::string filename, std::string im
   }
   auto rivers_min_source_altitude = rivers_min_source_altitude_node.as<double>();
 
+  auto random_mode = mm::random_mode::sequential;
+  auto random_node = node["random"];
+  if (random_node) {
+    auto random_name = random_node.as<std::string>();
+
+    if (random_name == "counter") {
+      random_mode = mm::random_mode::counter;
+    } else if (random_name != "sequential") {
+      std::printf("Warning! Unknown random mode: '%s'. Using sequential random mode.\n", random_name.c_str());
+    }
+  }
 
   bool output_intermediates = true;
 
@@ -836,7 +867,7 @@ void generate_akagoria_map(YAML::Node node, std::string filename, std::string im
    */
   auto watermap = compute_initial_watermap(map, sea_level);
 
-  auto rivers = generate_rivers(map, watermap, rivers_count, rivers_min_source_altitude, engine);
+  auto rivers = generate_rivers(map, watermap, rivers_count, rivers_min_source_altitude, engine, random_mode);
   for (auto river : rivers) {
     for (auto water : river) {
       watermap(water) = true;
@@ -16,6 +16,7 @@
 #include "generators.h"
 
 #include <cassert>
+#include <algorithm>
 #include <cinttypes>
 #include <chrono>
 
@@ -23,12 +24,14 @@
 #include <mm/curve.h>
 #include <mm/diamond_square.h>
 #include <mm/distance.h>
+#include <mm/fast_math.h>
 #include <mm/fractal.h>
 #include <mm/gradient_noise.h>
 #include <mm/hills.h>
 #include <mm/midpoint_displacement.h>
 #include <mm/normalize.h>
 #include <mm/simplex_noise.h>
+#include <mm/spectral.h>
 #include <mm/value_noise.h>
 
 #include "exception.h"
@@ -64,7 +67,7 @@ namespace mm {
    */
   typedef std::function<double(double)> curve_function;
 
-  static curve_function get_curve(const std::string& name) {
+  static curve_function get_curve(const std::string& name, bool fast_math) {
     if (name == "linear") {
       return curve_linear<double>;
     }
@@ -78,20 +81,114 @@ namespace mm {
     }
 
     if (name == "cosine") {
+      if (fast_math) {
+        return fast::curve_cosine<double>;
+      }
+
       return curve_cosine<double>;
     }
 
+    if (name == "cubic-lut") {
+      return curve_cubic_lut<double>;
+    }
+
+    if (name == "quintic-lut") {
+      return curve_quintic_lut<double>;
+    }
+
+    if (name == "cosine-lut") {
+      return curve_cosine_lut<double>;
+    }
+
     std::printf("Warning! Unknown curve: '%s'. Using linear curve.\n", name.c_str());
     return curve_linear<double>;
   }
 
-  typedef std::function<double(double,double)> noise_function;
+  static curve_function get_curve_derivative(const std::string& name) {
+    if (name == "cubic" || name == "cubic-lut") {
+      return curve_cubic_derivative<double>;
+    }
+
+    if (name == "quintic" || name == "quintic-lut") {
+      return curve_quintic_derivative<double>;
+    }
+
+    if (name == "cosine" || name == "cosine-lut") {
+      return curve_cosine_derivative<double>;
+    }
+
+    return curve_linear_derivative<double>;
+  }
+
+  static lattice get_lattice(YAML::Node node) {
+    if (!node) {
+      return lattice::permutation;
+    }
+
+    auto lattice_node = node["lattice"];
+
+    if (!lattice_node) {
+      return lattice::permutation;
+    }
+
+    auto name = lattice_node.as<std::string>();
+
+    if (name == "permutation") {
+      return lattice::permutation;
+    }
+
+    if (name == "hash") {
+      return lattice::hash;
+    }
+
+    std::printf("Warning! Unknown lattice: '%s'. Using permutation lattice.\n", name.c_str());
+    return lattice::permutation;
+  }
+
+  typedef fractal::line_function noise_function;
+
+  template<typename Noise>
+  static noise_function point_noise(Noise noise) {
+    return [noise](double x, const double *y, fractal::size_type count, double *values) {
+      for (fractal::size_type i = 0; i < count; ++i) {
+        values[i] = noise(x, y[i]);
+      }
+    };
+  }
+
+  template<typename Noise>
+  static noise_function line_noise(Noise noise) {
+    return [noise](double x, const double *y, fractal::size_type count, double *values) {
+      noise.line(x, y, count, values);
+    };
+  }
+
+  typedef fractal::derivative_function derivative_function;
 
-  static double null_noise(double x, double y) {
-    return 0.0;
+  template<typename Noise>
+  static derivative_function point_derivatives(Noise noise) {
+    return [noise](double x, const double *y, fractal::size_type count, double *values, double *dx, double *dy) {
+      for (fractal::size_type i = 0; i < count; ++i) {
+        vector2 derivatives;
+        values[i] = noise(x, y[i], derivatives);
+        dx[i] = derivatives.x;
+        dy[i] = derivatives.y;
+      }
+    };
+  }
+
+  template<typename Noise>
+  static derivative_function line_derivatives(Noise noise) {
+    return [noise](double x, const double *y, fractal::size_type count, double *values, double *dx, double *dy) {
+      noise.line(x, y, count, values, dx, dy);
+    };
   }
 
-  static noise_function get_gradient_noise(random_engine& engine, YAML::Node node) {
+  static void null_noise(double x, const double *y, fractal::size_type count, double *values) {
+    std::fill(values, values + count, 0.0);
+  }
+
+  static noise_function get_gradient_noise(random_engine& engine, YAML::Node node, derivative_function& derivatives) {
     auto curve_node = node["curve"];
 
     if (!curve_node) {
@@ -99,9 +196,12 @@ namespace mm {
     }
 
     auto curve_name = curve_node.as<std::string>();
-    auto curve = get_curve(curve_name);
+    auto fast_math_node = node["fast_math"];
+    auto curve = get_curve(curve_name, fast_math_node && fast_math_node.as<bool>());
 
-    return gradient_noise(engine, curve);
+    gradient_noise noise(engine, curve, get_curve_derivative(curve_name), get_lattice(node));
+    derivatives = line_derivatives(noise);
+    return line_noise(noise);
   }
 
   static noise_function get_value_noise(random_engine& engine, YAML::Node node) {
@@ -112,9 +212,10 @@ namespace mm {
     }
 
     auto curve_name = curve_node.as<std::string>();
-    auto curve = get_curve(curve_name);
+    auto fast_math_node = node["fast_math"];
+    auto curve = get_curve(curve_name, fast_math_node && fast_math_node.as<bool>());
 
-    return value_noise(engine, curve);
+    return line_noise(value_noise(engine, curve, get_lattice(node)));
   }
 
   typedef std::function<double(const vector2&, const vector2&)> distance_function;
@@ -165,23 +266,67 @@ namespace mm {
       coeffs.push_back(coeffs_node[i].as<double>()); // TODO: verify that it is a scalar
     }
 
-    return cell_noise(engine, count, distance, std::move(coeffs));
+    return point_noise(cell_noise(engine, count, distance, std::move(coeffs)));
   }
 
 
-  static noise_function get_simplex_noise(random_engine& engine, YAML::Node node) {
-    return simplex_noise(engine);
+  static noise_function get_simplex_noise(random_engine& engine, YAML::Node node, derivative_function& derivatives) {
+    simplex_noise noise(engine, get_lattice(node));
+    derivatives = point_derivatives(noise);
+    return point_noise(noise);
   }
   /*
    * Generators
    */
+  static random_mode get_random_mode(YAML::Node node) {
+    auto random_node = node["random"];
+
+    if (!random_node) {
+      return random_mode::sequential;
+    }
+
+    auto name = random_node.as<std::string>();
+
+    if (name == "sequential") {
+      return random_mode::sequential;
+    }
+
+    if (name == "counter") {
+      return random_mode::counter;
+    }
+
+    std::printf("Warning! Unknown random mode: '%s'. Using sequential random mode.\n", name.c_str());
+    return random_mode::sequential;
+  }
+
+  static grid_shape get_grid_shape(YAML::Node node) {
+    auto grid_node = node["grid"];
+
+    if (!grid_node) {
+      return grid_shape::square;
+    }
+
+    auto name = grid_node.as<std::string>();
+
+    if (name == "square") {
+      return grid_shape::square;
+    }
+
+    if (name == "blocks") {
+      return grid_shape::blocks;
+    }
+
+    std::printf("Warning! Unknown grid shape: '%s'. Using square grid shape.\n", name.c_str());
+    return grid_shape::square;
+  }
+
   static heightmap null_generator(random_engine&, position::size_type width, position::size_type height) {
     heightmap map(width, height);
     return map;
   }
 
 
-  static generator_function get_fractal_generator(random_engine& engine, YAML::Node node) {
+  static generator_function get_fractal_generator(random_engine& engine, YAML::Node node, derivative_generator_function& derivative_generator) {
     auto noise_node = node["noise"];
     if (!noise_node) {
       throw bad_structure("mapmaker: missing 'noise' in 'fractal' generator parameters");
@@ -193,16 +338,17 @@ namespace mm {
 //     }
 
     noise_function noise;
+    derivative_function derivatives;
     auto noise_name = noise_node.as<std::string>();
 
     if (noise_name == "gradient") {
-      noise = get_gradient_noise(engine, noise_parameters_node);
+      noise = get_gradient_noise(engine, noise_parameters_node, derivatives);
     } else if (noise_name == "cell") {
       noise = get_cell_noise(engine, noise_parameters_node);
     } else if (noise_name == "value") {
       noise = get_value_noise(engine, noise_parameters_node);
     } else if (noise_name == "simplex") {
-      noise = get_simplex_noise(engine, noise_parameters_node);
+      noise = get_simplex_noise(engine, noise_parameters_node, derivatives);
     } else {
       std::printf("Warning! Unknown noise: '%s'. Using null noise.\n", noise_name.c_str());
       noise = null_noise;
@@ -229,7 +375,52 @@ namespace mm {
     }
     auto persistence = persistence_node.as<double>();
 
-    return fractal(noise, scale, octaves, lacunarity, persistence);
+    auto limit = fractal::octave_limit::none;
+    auto limit_node = node["octave_limit"];
+
+    if (limit_node) {
+      auto limit_name = limit_node.as<std::string>();
+
+      if (limit_name == "nyquist") {
+        limit = fractal::octave_limit::nyquist;
+      } else if (limit_name == "fade") {
+        limit = fractal::octave_limit::fade;
+      } else if (limit_name != "none") {
+        std::printf("Warning! Unknown octave limit: '%s'. Using no limit.\n", limit_name.c_str());
+      }
+    }
+
+    auto derivatives_node = node["derivatives"];
+
+    if (derivatives_node && derivatives_node.as<bool>()) {
+      if (!derivatives) {
+        std::printf("Warning! No derivatives for noise: '%s'. Using the differences between the pixels.\n", noise_name.c_str());
+      }
+    } else {
+      derivatives = nullptr;
+    }
+
+    fractal generator(noise, derivatives, scale, octaves, lacunarity, persistence, limit);
+
+    auto print_octaves = [generator, octaves](position::size_type width, position::size_type height) {
+      auto computed = generator.octaves(width, height);
+
+      if (computed < octaves) {
+        std::printf("\toctaves: %zu (%zu skipped)\n", computed, octaves - computed);
+      }
+    };
+
+    if (generator.has_derivatives()) {
+      derivative_generator = [generator, print_octaves](random_engine& engine, position::size_type width, position::size_type height, heightmap& dx, heightmap& dy) {
+        print_octaves(width, height);
+        return generator(engine, width, height, dx, dy);
+      };
+    }
+
+    return [generator, print_octaves](random_engine& engine, position::size_type width, position::size_type height) {
+      print_octaves(width, height);
+      return generator(engine, width, height);
+    };
   }
 
 
@@ -249,13 +440,13 @@ namespace mm {
         values.at(i) = values_node[i].as<double>(); // TODO: verify that it is a scalar
       }
 
-      return diamond_square(values[0], values[1], values[2], values[3]);
+      return diamond_square(values[0], values[1], values[2], values[3], get_random_mode(node), get_grid_shape(node));
     }
 
     assert(values_node.IsScalar());
 
     double value = values_node.as<double>();
-    return diamond_square(value);
+    return diamond_square(value, get_random_mode(node), get_grid_shape(node));
   }
 
   static generator_function get_midpoint_displacement_generator(random_engine& engine, YAML::Node node) {
@@ -274,13 +465,13 @@ namespace mm {
         values.at(i) = values_node[i].as<double>(); // TODO: verify that it is a scalar
       }
 
-      return midpoint_displacement(values[0], values[1], values[2], values[3]);
+      return midpoint_displacement(values[0], values[1], values[2], values[3], get_random_mode(node), get_grid_shape(node));
     }
 
     assert(values_node.IsScalar());
 
     double value = values_node.as<double>();
-    return midpoint_displacement(value);
+    return midpoint_displacement(value, get_random_mode(node), get_grid_shape(node));
   }
 
 
@@ -303,7 +494,18 @@ namespace mm {
     }
     auto radius_max = radius_max_node.as<double>();
 
-    return hills(count, radius_min, radius_max);
+    return hills(count, radius_min, radius_max, get_random_mode(node));
+  }
+
+  static generator_function get_spectral_generator(random_engine&, YAML::Node node) {
+    double beta = 2.0;
+
+    auto beta_node = node["beta"];
+    if (beta_node) {
+      beta = beta_node.as<double>();
+    }
+
+    return spectral(beta);
   }
 
   static generator_function get_ramp_generator(random_engine& engine, YAML::Node node) {
@@ -314,7 +516,7 @@ namespace mm {
    * API
    */
 
-  generator_function get_generator(random_engine& engine, YAML::Node node) {
+  generator_function get_generator(random_engine& engine, YAML::Node node, derivative_generator_function& derivatives) {
     auto name_node = node["name"];
     if (!name_node) {
       throw bad_structure("mapmaker: missing 'name' in generator definition");
@@ -326,7 +528,7 @@ namespace mm {
     auto parameters_node = node["parameters"];
 
     if (name == "fractal") {
-      return get_fractal_generator(engine, parameters_node);
+      return get_fractal_generator(engine, parameters_node, derivatives);
     }
 
     if (name == "diamond-square") {
@@ -341,6 +543,10 @@ namespace mm {
       return get_hills_generator(engine, parameters_node);
     }
 
+    if (name == "spectral") {
+      return get_spectral_generator(engine, parameters_node);
+    }
+
     if (name == "ramp") {
       return get_ramp_generator(engine, parameters_node);
     }
@@ -348,7 +554,30 @@ namespace mm {
     return null_generator;
   }
 
-  heightmap generate(random_engine& engine, generator_function generator, YAML::Node node) {
+  // the derivatives are only useful for a shaded output
+  static bool is_shaded(YAML::Node output_node) {
+    if (!output_node || !output_node["type"] || output_node["type"].as<std::string>() != "colored") {
+      return false;
+    }
+
+    auto shaded_node = output_node["parameters"]["shaded"];
+    return shaded_node && shaded_node.as<bool>();
+  }
+
+  // the range of the values of the map, normalize divides the map by this range
+  static double get_range(const heightmap& map) {
+    auto min = map(0, 0);
+    auto max = map(0, 0);
+
+    for (auto pos : map.positions()) {
+      min = std::min(min, map(pos));
+      max = std::max(max, map(pos));
+    }
+
+    return max - min;
+  }
+
+  heightmap generate(random_engine& engine, generator_function generator, YAML::Node node, derivative_generator_function derivatives) {
     auto size_node = node["size"];
     if (!size_node) {
       throw bad_structure("mapmaker: missing 'size' in generator definition");
@@ -368,17 +597,34 @@ namespace mm {
 
     std::printf("\tsize: %zu x %zu\n", width, height);
 
+    auto output_node = node["output"];
+    bool with_derivatives = derivatives && is_shaded(output_node);
+    heightmap dx;
+    heightmap dy;
+
     auto start = std::chrono::steady_clock::now();
-    auto map = generator(engine, width, height);
+    auto map = with_derivatives ? derivatives(engine, width, height, dx, dy) : generator(engine, width, height);
+
+    if (with_derivatives) {
+      double factor = 1.0 / get_range(map);
+
+      for (auto pos : map.positions()) {
+        dx(pos) *= factor;
+        dy(pos) *= factor;
+      }
+    }
+
     map = normalize()(map);
     auto end = std::chrono::steady_clock::now();
     auto elapsed = end - start;
     std::printf("\tduration: %" PRId64 " ms\n", std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
 
-    auto output_node = node["output"];
-
     if (output_node) {
-      output_heightmap(map, output_node, engine);
+      if (with_derivatives) {
+        output_heightmap(map, dx, dy, output_node, engine);
+      } else {
+        output_heightmap(map, output_node, engine);
+      }
     }
 
     return map;
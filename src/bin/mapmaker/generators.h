@@ -26,8 +26,12 @@ namespace mm {
 
   typedef std::function<heightmap(random_engine&, position::size_type, position::size_type)> generator_function;
 
-  generator_function get_generator(random_engine& engine, YAML::Node node);
-  heightmap generate(random_engine& engine, generator_function generator, YAML::Node node);
+  // a generator that also computes the partial derivatives of the map
+  typedef std::function<heightmap(random_engine&, position::size_type, position::size_type, heightmap&, heightmap&)> derivative_generator_function;
+
+  // derivatives is set if the generator can compute the derivatives
+  generator_function get_generator(random_engine& engine, YAML::Node node, derivative_generator_function& derivatives);
+  heightmap generate(random_engine& engine, generator_function generator, YAML::Node node, derivative_generator_function derivatives = nullptr);
 
 }
 
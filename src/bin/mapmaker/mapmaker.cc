@@ -18,6 +18,8 @@
 
 #include <yaml-cpp/yaml.h>
 
+#include <mm/thread_pool.h>
+
 #include "exception.h"
 #include "process.h"
 
@@ -48,6 +50,11 @@ int main(int argc, char *argv[]) {
 
     mm::random_engine engine(seed);
 
+    auto threads_node = node["threads"];
+    if (threads_node) {
+      mm::set_thread_count(threads_node.as<mm::thread_pool::size_type>());
+    }
+
     auto map = mm::process_generator(node, engine);
     map = mm::process_modifiers(map, node, engine);
     mm::process_finalizer(map, node, engine);
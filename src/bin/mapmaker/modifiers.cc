@@ -17,14 +17,20 @@
 
 #include <cinttypes>
 #include <chrono>
+#include <cmath>
 
+#include <mm/droplet_erosion.h>
 #include <mm/fast_erosion.h>
 #include <mm/flatten.h>
 #include <mm/gaussize.h>
 #include <mm/hydraulic_erosion.h>
 #include <mm/islandize.h>
+#include <mm/land_mask.h>
+#include <mm/multiresolution.h>
 #include <mm/normalize.h>
 #include <mm/smooth.h>
+#include <mm/stream_power_erosion.h>
+#include <mm/temporal_blocking.h>
 #include <mm/thermal_erosion.h>
 
 #include "exception.h"
@@ -68,6 +74,77 @@ namespace mm {
     return map;
   }
 
+  static bool get_fast_math(YAML::Node node) {
+    auto fast_math_node = node["fast_math"];
+    return fast_math_node && fast_math_node.as<bool>();
+  }
+
+  template<typename T>
+  static T get_optional(YAML::Node node, const char *key, T value) {
+    auto value_node = node[key];
+    return value_node ? value_node.as<T>() : value;
+  }
+
+  // stops the modifier when the map does not change more than the
+  // tolerance, and prints the number of computed iterations
+  template<typename Modifier>
+  static modifier_function with_tolerance(Modifier modifier) {
+    return [modifier](const heightmap& src) {
+      typename Modifier::size_type iterations;
+      auto map = modifier(src, iterations);
+
+      print_indent();
+      std::printf("\titerations: %zu\n", iterations);
+
+      return map;
+    };
+  }
+
+  // computes some iterations of a level of a coarse to fine modifier, and
+  // prints the number of computed iterations of the level if the modifier
+  // has a tolerance
+  template<typename Modifier>
+  static heightmap compute_level(Modifier modifier, const heightmap& map, multiresolution::size_type level, double tolerance) {
+    typename Modifier::size_type iterations;
+    auto result = modifier(map, iterations);
+
+    if (tolerance > 0) {
+      print_indent();
+      std::printf("\titerations (level %zu): %zu\n", level, iterations);
+    }
+
+    return result;
+  }
+
+  static land_mask get_land_mask(YAML::Node node) {
+    auto sea_level_node = node["sea_level"];
+    if (!sea_level_node) {
+      throw bad_structure("mapmaker: missing 'sea_level' in 'mask' parameters");
+    }
+    auto sea_level = sea_level_node.as<double>();
+
+    auto margin = get_optional<land_mask::size_type>(node, "margin", 0);
+
+    return land_mask(sea_level, margin);
+  }
+
+  // only modifies the cells of the mask, computed on the map before the
+  // modifier, and prints the number of computed iterations if needed
+  template<typename Modifier>
+  static modifier_function with_mask(Modifier modifier, land_mask mask, bool print_iterations) {
+    return [modifier, mask, print_iterations](const heightmap& src) {
+      typename Modifier::size_type iterations;
+      auto map = modifier(src, mask(src), iterations);
+
+      if (print_iterations) {
+        print_indent();
+        std::printf("\titerations: %zu\n", iterations);
+      }
+
+      return map;
+    };
+  }
+
   static modifier_function get_intercept_modifier(YAML::Node node, random_engine& engine) {
     return intercept(node, engine);
   }
@@ -79,7 +156,7 @@ namespace mm {
     }
     auto border = border_node.as<double>();
 
-    return islandize(border * size);
+    return islandize(border * size, get_fast_math(node));
   }
 
   static modifier_function get_gaussize_modifier(YAML::Node node, heightmap::size_type size) {
@@ -89,7 +166,7 @@ namespace mm {
     }
     auto spread = spread_node.as<double>();
 
-    return gaussize(spread * size);
+    return gaussize(spread * size, get_fast_math(node));
   }
 
   static modifier_function get_thermal_erosion_modifier(YAML::Node node, heightmap::size_type size) {
@@ -111,6 +188,41 @@ namespace mm {
     }
     auto fraction = fraction_node.as<double>();
 
+    auto levels = get_optional<multiresolution::size_type>(node, "levels", 1);
+    auto tolerance = get_optional(node, "tolerance", 0.0);
+    auto mask_node = node["mask"];
+    auto blocking = get_optional<temporal_blocking::size_type>(node, "blocking", 1);
+
+    if (levels > 1 && mask_node) {
+      throw bad_structure("mapmaker: 'mask' can not be used with 'levels' in 'thermal-erosion' modifier parameters");
+    }
+
+    if (blocking > 1 && (levels > 1 || tolerance > 0 || mask_node)) {
+      throw bad_structure("mapmaker: 'blocking' can not be used with 'levels', 'tolerance' or 'mask' in 'thermal-erosion' modifier parameters");
+    }
+
+    if (levels > 1) {
+      // a coarse cell covers 2^level cells, the talus between two coarse cells is bigger
+      return multiresolution(levels, iterations, [talus, size, fraction, tolerance](const heightmap& map, multiresolution::size_type level, multiresolution::size_type level_iterations) {
+        return compute_level(thermal_erosion(level_iterations, talus * (1 << level) / size, fraction, tolerance), map, level, tolerance);
+      });
+    }
+
+    if (mask_node) {
+      return with_mask(thermal_erosion(iterations, talus / size, fraction, tolerance), get_land_mask(mask_node), tolerance > 0);
+    }
+
+    if (tolerance > 0) {
+      return with_tolerance(thermal_erosion(iterations, talus / size, fraction, tolerance));
+    }
+
+    if (blocking > 1) {
+      // an iteration depends on the cells at distance 2
+      return temporal_blocking(iterations, blocking, 2, [talus, size, fraction](const heightmap& map, temporal_blocking::size_type block_iterations) {
+        return thermal_erosion(block_iterations, talus / size, fraction)(map);
+      });
+    }
+
     return thermal_erosion(iterations, talus / size, fraction);
   }
 
@@ -133,6 +245,32 @@ namespace mm {
     }
     auto fraction = fraction_node.as<double>();
 
+    auto levels = get_optional<multiresolution::size_type>(node, "levels", 1);
+    auto tolerance = get_optional(node, "tolerance", 0.0);
+    auto blocking = get_optional<temporal_blocking::size_type>(node, "blocking", 1);
+
+    if (blocking > 1 && (levels > 1 || tolerance > 0)) {
+      throw bad_structure("mapmaker: 'blocking' can not be used with 'levels' or 'tolerance' in 'fast-erosion' modifier parameters");
+    }
+
+    if (levels > 1) {
+      // a coarse cell covers 2^level cells, the talus between two coarse cells is bigger
+      return multiresolution(levels, iterations, [talus, size, fraction, tolerance](const heightmap& map, multiresolution::size_type level, multiresolution::size_type level_iterations) {
+        return compute_level(fast_erosion(level_iterations, talus * (1 << level) / size, fraction, tolerance), map, level, tolerance);
+      });
+    }
+
+    if (tolerance > 0) {
+      return with_tolerance(fast_erosion(iterations, talus / size, fraction, tolerance));
+    }
+
+    if (blocking > 1) {
+      // an iteration depends on the cells at distance 2
+      return temporal_blocking(iterations, blocking, 2, [talus, size, fraction](const heightmap& map, temporal_blocking::size_type block_iterations) {
+        return fast_erosion(block_iterations, talus / size, fraction)(map);
+      });
+    }
+
     return fast_erosion(iterations, talus / size, fraction);
   }
 
@@ -167,9 +305,75 @@ namespace mm {
     }
     auto capacity = capacity_node.as<double>();
 
+    auto levels = get_optional<multiresolution::size_type>(node, "levels", 1);
+    auto tolerance = get_optional(node, "tolerance", 0.0);
+    auto mask_node = node["mask"];
+
+    if (levels > 1 && mask_node) {
+      throw bad_structure("mapmaker: 'mask' can not be used with 'levels' in 'hydraulic-erosion' modifier parameters");
+    }
+
+    if (levels > 1) {
+      return multiresolution(levels, iterations, [rain, solubility, evaporation, capacity, tolerance](const heightmap& map, multiresolution::size_type level, multiresolution::size_type level_iterations) {
+        return compute_level(hydraulic_erosion(level_iterations, rain, solubility, evaporation, capacity, tolerance), map, level, tolerance);
+      });
+    }
+
+    if (mask_node) {
+      return with_mask(hydraulic_erosion(iterations, rain, solubility, evaporation, capacity, tolerance), get_land_mask(mask_node), tolerance > 0);
+    }
+
+    if (tolerance > 0) {
+      return with_tolerance(hydraulic_erosion(iterations, rain, solubility, evaporation, capacity, tolerance));
+    }
+
     return hydraulic_erosion(iterations, rain, solubility, evaporation, capacity);
   }
 
+  static modifier_function get_droplet_erosion_modifier(YAML::Node node, random_engine& engine) {
+    auto droplets_node = node["droplets"];
+    if (!droplets_node) {
+      throw bad_structure("mapmaker: missing 'droplets' in 'droplet-erosion' modifier parameters");
+    }
+    auto droplets = droplets_node.as<droplet_erosion::size_type>();
+
+    auto lifetime = get_optional<droplet_erosion::size_type>(node, "lifetime", 30);
+    auto inertia = get_optional(node, "inertia", 0.05);
+    auto capacity = get_optional(node, "capacity", 4.0);
+    auto min_capacity = get_optional(node, "min_capacity", 0.01);
+    auto deposition = get_optional(node, "deposition", 0.3);
+    auto erosion = get_optional(node, "erosion", 0.3);
+    auto evaporation = get_optional(node, "evaporation", 0.01);
+    auto gravity = get_optional(node, "gravity", 4.0);
+    auto radius = get_optional<droplet_erosion::size_type>(node, "radius", 3);
+
+    return droplet_erosion(engine(), droplets, lifetime, inertia, capacity, min_capacity, deposition, erosion, evaporation, gravity, radius);
+  }
+
+  static modifier_function get_stream_power_erosion_modifier(YAML::Node node, heightmap::size_type size) {
+    auto iterations_node = node["iterations"];
+    if (!iterations_node) {
+      throw bad_structure("mapmaker: missing 'iterations' in 'stream-power-erosion' modifier parameters");
+    }
+    auto iterations = iterations_node.as<stream_power_erosion::size_type>();
+
+    auto erosion_node = node["erosion"];
+    if (!erosion_node) {
+      throw bad_structure("mapmaker: missing 'erosion' in 'stream-power-erosion' modifier parameters");
+    }
+    auto erosion = erosion_node.as<double>();
+
+    auto time_step = get_optional(node, "time_step", 1.0);
+    auto area_exponent = get_optional(node, "area_exponent", 0.5);
+    auto uplift = get_optional(node, "uplift", 0.0);
+
+    // the area is a fraction of the map and the slope is relative to the
+    // size of the map, like the talus of the other erosions
+    double scale = std::pow(static_cast<double>(size), 1.0 - 2.0 * area_exponent);
+
+    return stream_power_erosion(iterations, erosion * scale, time_step, area_exponent, uplift);
+  }
+
   static modifier_function get_flatten_modifier(YAML::Node node, heightmap::size_type size) {
     auto factor_node = node["factor"];
     if (!factor_node) {
@@ -177,7 +381,7 @@ namespace mm {
     }
     auto factor = factor_node.as<double>();
 
-    return flatten(factor);
+    return flatten(factor, get_fast_math(node));
   }
 
   static modifier_function get_smooth_modifier(YAML::Node node, heightmap::size_type size) {
@@ -187,6 +391,29 @@ namespace mm {
     }
     auto iterations = iterations_node.as<smooth::size_type>();
 
+    auto tolerance = get_optional(node, "tolerance", 0.0);
+    auto mask_node = node["mask"];
+    auto blocking = get_optional<temporal_blocking::size_type>(node, "blocking", 1);
+
+    if (blocking > 1 && (tolerance > 0 || mask_node)) {
+      throw bad_structure("mapmaker: 'blocking' can not be used with 'tolerance' or 'mask' in 'smooth' modifier parameters");
+    }
+
+    if (mask_node) {
+      return with_mask(smooth(iterations, tolerance), get_land_mask(mask_node), tolerance > 0);
+    }
+
+    if (tolerance > 0) {
+      return with_tolerance(smooth(iterations, tolerance));
+    }
+
+    if (blocking > 1) {
+      // an iteration depends on the cells at distance 1
+      return temporal_blocking(iterations, blocking, 1, [](const heightmap& map, temporal_blocking::size_type block_iterations) {
+        return smooth(block_iterations)(map);
+      });
+    }
+
     return smooth(iterations);
   }
 
@@ -226,6 +453,14 @@ namespace mm {
       return get_hydraulic_erosion_modifier(parameters_node, size);
     }
 
+    if (name == "droplet-erosion") {
+      return get_droplet_erosion_modifier(parameters_node, engine);
+    }
+
+    if (name == "stream-power-erosion") {
+      return get_stream_power_erosion_modifier(parameters_node, size);
+    }
+
     if (name == "thermal-erosion") {
       return get_thermal_erosion_modifier(parameters_node, size);
     }
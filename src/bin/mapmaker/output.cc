@@ -27,7 +27,7 @@
 
 namespace mm {
 
-  void output_heightmap(const heightmap& map, YAML::Node node, random_engine& engine) {
+  static void output(const heightmap& map, const heightmap *dx, const heightmap *dy, YAML::Node node, random_engine& engine) {
     auto filename_node = node["filename"];
     if (!filename_node) {
       throw bad_structure("mapmaker: missing 'filename' in output definition");
@@ -65,7 +65,11 @@ namespace mm {
       auto colored = colorize(ramp, sea_level)(map);
 
       if (shaded) {
-        colored = shader(sea_level)(colored, map);
+        if (dx != nullptr && dy != nullptr) {
+          colored = shader(sea_level)(colored, map, *dx, *dy);
+        } else {
+          colored = shader(sea_level)(colored, map);
+        }
       }
 
       colored.output_to_ppm(filename);
@@ -136,4 +140,12 @@ namespace mm {
 
   }
 
+  void output_heightmap(const heightmap& map, YAML::Node node, random_engine& engine) {
+    output(map, nullptr, nullptr, node, engine);
+  }
+
+  void output_heightmap(const heightmap& map, const heightmap& dx, const heightmap& dy, YAML::Node node, random_engine& engine) {
+    output(map, &dx, &dy, node, engine);
+  }
+
 }
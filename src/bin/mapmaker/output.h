@@ -27,6 +27,9 @@ namespace mm {
 
   void output_heightmap(const heightmap& map, YAML::Node node, random_engine& engine);
 
+  // with the partial derivatives of the map, used for the shading
+  void output_heightmap(const heightmap& map, const heightmap& dx, const heightmap& dy, YAML::Node node, random_engine& engine);
+
 }
 
 #endif // OUTPUT_H
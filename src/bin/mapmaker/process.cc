@@ -29,8 +29,9 @@ namespace mm {
       throw mm::bad_structure("mapmaker: missing 'generator' definition");
     }
 
-    auto generator = mm::get_generator(engine, generator_node);
-    auto map = mm::generate(engine, generator, generator_node);
+    mm::derivative_generator_function derivatives;
+    auto generator = mm::get_generator(engine, generator_node, derivatives);
+    auto map = mm::generate(engine, generator, generator_node, derivatives);
 
     return map;
   }
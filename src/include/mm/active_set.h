@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_ACTIVE_SET_H
+#define MM_ACTIVE_SET_H
+
+#include <cstddef>
+#include <vector>
+
+#include <mm/binarymap.h>
+
+namespace mm {
+
+  /**
+   * The active cells of an iterative modifier where the next value of a
+   * cell only depends on the cells at distance 2 (like the erosions). The
+   * columns of the map are divided in blocks of rows, a block is active if
+   * a cell at distance 2 changed in the previous iteration. The other
+   * blocks would not change, they can be skipped and the result is the
+   * same.
+   *
+   * With a mask, only the blocks with a cell of the mask can be active.
+   *
+   * The blocks of each column are visited as runs of consecutive blocks.
+   * The source runs are the rows that the active rows of the column and its
+   * two neighbour columns can depend on.
+   */
+  class active_set {
+  public:
+    typedef std::size_t size_type;
+
+    static constexpr size_type block_size = 64;
+
+    // all the blocks are active
+    active_set(size_type width, size_type height);
+
+    // the blocks with a cell of the mask are active, an empty mask has all
+    // the cells
+    active_set(size_type width, size_type height, const binarymap& mask);
+
+    bool is_active(size_type x) const {
+      return m_active_columns[x];
+    }
+
+    bool is_source(size_type x) const {
+      return m_source_columns[x];
+    }
+
+    // calls func(y_begin, y_end) for each run of active rows of column x
+    template<typename Function>
+    void for_each_active_run(size_type x, Function func) const {
+      for_each_run(m_active, x, func);
+    }
+
+    // calls func(y_begin, y_end) for each run of rows of column x that are
+    // needed by the active rows of columns x - 1, x and x + 1
+    template<typename Function>
+    void for_each_source_run(size_type x, Function func) const {
+      for_each_run(m_source, x, func);
+    }
+
+    // marks the blocks of rows [y_begin, y_end) of column x where the
+    // values changed, the columns can be compared in parallel
+    void compare(size_type x, size_type y_begin, size_type y_end, const double *before, const double *after);
+
+    // computes the active blocks from the changed blocks, and forgets the
+    // changed blocks
+    void update();
+
+    // the number of active blocks
+    size_type active_blocks() const;
+
+  private:
+    size_type m_width;
+    size_type m_height;
+    size_type m_blocks;
+    std::vector<char> m_mask;
+    std::vector<char> m_changed;
+    std::vector<char> m_active;
+    std::vector<char> m_source;
+    std::vector<char> m_active_columns;
+    std::vector<char> m_source_columns;
+
+    void compute_columns();
+
+    template<typename Function>
+    void for_each_run(const std::vector<char>& blocks, size_type x, Function func) const {
+      const char *column = blocks.data() + x * m_blocks;
+      size_type b = 0;
+
+      while (b < m_blocks) {
+        if (!column[b]) {
+          ++b;
+          continue;
+        }
+
+        size_type e = b + 1;
+
+        while (e < m_blocks && column[e]) {
+          ++e;
+        }
+
+        func(b * block_size, e == m_blocks ? m_height : e * block_size);
+        b = e;
+      }
+    }
+  };
+
+}
+
+#endif // MM_ACTIVE_SET_H
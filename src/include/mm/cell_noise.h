@@ -28,15 +28,27 @@ namespace mm {
   public:
     typedef std::size_t size_type;
 
+    // the distance must not be smaller than the chebyshev distance (this is
+    // true for the manhattan, euclidean and chebyshev distances)
     cell_noise(random_engine& engine, size_type count, std::function<double(const vector2&, const vector2&)> distance, std::vector<double> coeffs);
 
-    double operator()(double x, double y);
+    double operator()(double x, double y) const;
 
   private:
     size_type m_count;
     std::function<double(const vector2&, const vector2&)> m_distance;
     std::vector<double> m_coeffs;
     std::vector<vector2> m_cells;
+
+    // uniform grid over the cells, the cells of a bucket are in
+    // m_buckets[m_bucket_start[b], m_bucket_start[b+1])
+    size_type m_grid_size;
+    vector2 m_grid_min;
+    double m_grid_step;
+    std::vector<size_type> m_bucket_start;
+    std::vector<vector2> m_buckets;
+
+    size_type bucket_index(double value, double min) const;
   };
 
 }
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_CHUNK_CACHE_H
+#define MM_CHUNK_CACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <mm/heightmap.h>
+
+namespace mm {
+
+  // a thread-safe cache of the most recently used chunks of an unbounded map
+  class chunk_cache {
+  public:
+    typedef std::size_t size_type;
+    typedef std::function<heightmap(int64_t, int64_t)> chunk_function;
+    typedef std::shared_ptr<const heightmap> chunk_pointer;
+
+    // the chunk function is called concurrently from several threads, the
+    // prefetched chunks are computed by `threads` background threads
+    chunk_cache(chunk_function chunk, size_type capacity, size_type threads = 1);
+
+    // waits for the chunks that are being prefetched, the others are dropped
+    ~chunk_cache();
+
+    chunk_cache(const chunk_cache&) = delete;
+    chunk_cache& operator=(const chunk_cache&) = delete;
+
+    // the chunk (cx, cy), computed in the calling thread if it is neither
+    // cached nor being prefetched
+    chunk_pointer get(int64_t cx, int64_t cy);
+
+    // queues the chunks around (cx, cy) for the background threads, the
+    // cache never has more than `capacity` chunks so the least recently
+    // used chunks (including the queued ones) are dropped
+    void prefetch(int64_t cx, int64_t cy, int64_t radius = 1);
+
+  private:
+    typedef std::pair<int64_t, int64_t> key_type;
+    typedef std::shared_ptr<std::promise<chunk_pointer>> promise_pointer;
+
+    struct entry {
+      std::shared_future<chunk_pointer> chunk;
+      std::list<key_type>::iterator lru;
+      uint64_t id;
+      promise_pointer queued; // not null while waiting for a background thread
+    };
+
+    struct task {
+      key_type key;
+      uint64_t id;
+    };
+
+    chunk_function m_chunk;
+    size_type m_capacity;
+
+    std::mutex m_mutex;
+    std::list<key_type> m_lru; // most recently used first
+    std::map<key_type, entry> m_entries;
+    uint64_t m_next_id;
+
+    std::deque<task> m_queue;
+    std::condition_variable m_wake;
+    bool m_stop;
+    std::vector<std::thread> m_workers;
+
+    entry& insert(const key_type& key, promise_pointer promise);
+    chunk_pointer compute(const key_type& key, uint64_t id, promise_pointer promise);
+    void touch(entry& e);
+    void evict();
+    void work();
+  };
+
+}
+
+#endif // MM_CHUNK_CACHE_H
@@ -17,6 +17,7 @@
 #define MM_CURVE_H
 
 #include <cmath>
+#include <cstddef>
 
 namespace mm {
 
@@ -54,6 +55,103 @@ namespace mm {
     return (1 - std::cos(M_PI * t)) * 0.5;
   }
 
+  // derivatives of the curves, for the analytic derivatives of the noises
+
+  // 1
+  template<typename T>
+  constexpr
+  T curve_linear_derivative(T) {
+    return 1;
+  }
+
+  // -6 * x ** 2 + 6 * x
+  template<typename T>
+  constexpr
+  T curve_cubic_derivative(T t) {
+    return -6 * t * t + 6 * t;
+  }
+
+  // 30 * x ** 4 - 60 * x ** 3 + 30 * x ** 2
+  template<typename T>
+  constexpr
+  T curve_quintic_derivative(T t) {
+    return 30 * t * t * t * t - 60 * t * t * t + 30 * t * t;
+  }
+
+  // sin(pi * x) * pi * 0.5
+  template<typename T>
+  constexpr
+  T curve_cosine_derivative(T t) {
+    return std::sin(M_PI * t) * M_PI * 0.5;
+  }
+
+  // tabulated curves, computed at compile time and linearly interpolated,
+  // the error is below 1e-6
+
+  constexpr std::size_t curve_table_size = 1024;
+
+  namespace details {
+
+    struct curve_table {
+      double values[curve_table_size + 1];
+    };
+
+    constexpr curve_table make_curve_table(double (*curve)(double)) {
+      curve_table table{};
+
+      for (std::size_t i = 0; i <= curve_table_size; ++i) {
+        table.values[i] = curve(static_cast<double>(i) / curve_table_size);
+      }
+
+      return table;
+    }
+
+    // cos(x) for x in [0, pi/2], Taylor series, usable in a constant expression
+    constexpr double cosine_series(double x) {
+      double sum = 0.0;
+      double term = 1.0;
+
+      for (int n = 1; n <= 15; ++n) {
+        sum += term;
+        term *= -x * x / ((2 * n - 1) * (2 * n));
+      }
+
+      return sum;
+    }
+
+    constexpr double curve_cosine_series(double t) {
+      return t <= 0.5 ? (1 - cosine_series(M_PI * t)) * 0.5 : (1 + cosine_series(M_PI * (1 - t))) * 0.5;
+    }
+
+    template<typename T>
+    T curve_table_lookup(const curve_table& table, T t) {
+      T x = t * curve_table_size;
+      x = x < 0 ? 0 : (x > curve_table_size ? curve_table_size : x);
+      std::size_t i = static_cast<std::size_t>(x);
+      i = i < curve_table_size ? i : curve_table_size - 1;
+      return lerp(table.values[i], table.values[i + 1], x - i);
+    }
+
+  }
+
+  template<typename T>
+  T curve_cubic_lut(T t) {
+    static constexpr details::curve_table table = details::make_curve_table(curve_cubic<double>);
+    return details::curve_table_lookup(table, t);
+  }
+
+  template<typename T>
+  T curve_quintic_lut(T t) {
+    static constexpr details::curve_table table = details::make_curve_table(curve_quintic<double>);
+    return details::curve_table_lookup(table, t);
+  }
+
+  template<typename T>
+  T curve_cosine_lut(T t) {
+    static constexpr details::curve_table table = details::make_curve_table(details::curve_cosine_series);
+    return details::curve_table_lookup(table, t);
+  }
+
 }
 
 
@@ -16,6 +16,7 @@
 #ifndef MM_DIAMOND_SQUARE_H
 #define MM_DIAMOND_SQUARE_H
 
+#include <mm/grid_shape.h>
 #include <mm/random.h>
 #include <mm/heightmap.h>
 
@@ -25,13 +26,13 @@ namespace mm {
   public:
     typedef typename position::size_type size_type;
 
-    diamond_square(double val = 0.0)
-    : m_nw(val), m_ne(val), m_se(val), m_sw(val)
+    diamond_square(double val = 0.0, random_mode mode = random_mode::sequential, grid_shape shape = grid_shape::square)
+    : m_nw(val), m_ne(val), m_se(val), m_sw(val), m_mode(mode), m_shape(shape)
     {
     }
 
-    diamond_square(double nw, double ne, double se, double sw)
-    : m_nw(nw), m_ne(ne), m_se(se), m_sw(sw)
+    diamond_square(double nw, double ne, double se, double sw, random_mode mode = random_mode::sequential, grid_shape shape = grid_shape::square)
+    : m_nw(nw), m_ne(ne), m_se(se), m_sw(sw), m_mode(mode), m_shape(shape)
     {
     }
 
@@ -42,6 +43,8 @@ namespace mm {
     double m_ne;
     double m_se;
     double m_sw;
+    random_mode m_mode;
+    grid_shape m_shape;
   };
 
 
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_DROPLET_EROSION_H
+#define MM_DROPLET_EROSION_H
+
+#include <cstdint>
+
+#include <mm/heightmap.h>
+
+namespace mm {
+
+  /**
+   * Particle erosion: droplets of water fall on the map, run downhill, erode
+   * the terrain where they accelerate and deposit their sediment where they
+   * slow down. The cost depends on the number of droplets, not on the size
+   * of the map.
+   *
+   * The map is divided in tiles that are large enough so that the droplets
+   * of two tiles of the same color (in a 2x2 pattern) can not reach the same
+   * cells. The tiles of a color are computed in parallel, and the result is
+   * the same for any number of threads.
+   */
+  class droplet_erosion {
+  public:
+    typedef std::size_t size_type;
+
+    droplet_erosion(uint64_t seed, size_type droplets, size_type lifetime = 30, double inertia = 0.05, double capacity = 4.0, double min_capacity = 0.01, double deposition = 0.3, double erosion = 0.3, double evaporation = 0.01, double gravity = 4.0, size_type radius = 3)
+    : m_seed(seed)
+    , m_droplets(droplets)
+    , m_lifetime(lifetime)
+    , m_inertia(inertia)
+    , m_capacity(capacity)
+    , m_min_capacity(min_capacity)
+    , m_deposition(deposition)
+    , m_erosion(erosion)
+    , m_evaporation(evaporation)
+    , m_gravity(gravity)
+    , m_radius(radius)
+    {
+    }
+
+    heightmap operator()(const heightmap& src) const;
+
+  private:
+    uint64_t m_seed;
+    size_type m_droplets;
+    size_type m_lifetime;
+    double m_inertia;
+    double m_capacity;
+    double m_min_capacity;
+    double m_deposition;
+    double m_erosion;
+    double m_evaporation;
+    double m_gravity;
+    size_type m_radius;
+
+    struct brush;
+    void simulate(heightmap& map, const brush& erosion_brush, double x, double y) const;
+  };
+
+}
+
+#endif // MM_DROPLET_EROSION_H
@@ -24,17 +24,25 @@ namespace mm {
   public:
     typedef std::size_t size_type;
 
-    fast_erosion(size_type iterations, double talus, double fraction)
-    : m_iterations(iterations), m_talus(talus), m_fraction(fraction)
+    fast_erosion(size_type iterations, double talus, double fraction, double tolerance = 0.0)
+    : m_iterations(iterations), m_talus(talus), m_fraction(fraction), m_tolerance(tolerance)
     {
     }
 
-    heightmap operator()(const heightmap& src) const;
+    heightmap operator()(const heightmap& src) const {
+      size_type iterations;
+      return (*this)(src, iterations);
+    }
+
+    // stops when no cell changes more than the tolerance, and gives the
+    // number of computed iterations
+    heightmap operator()(const heightmap& src, size_type& iterations) const;
 
   private:
     size_type m_iterations;
     double m_talus;
     double m_fraction;
+    double m_tolerance;
 
   };
 
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_FAST_MATH_H
+#define MM_FAST_MATH_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace mm {
+
+  /*
+   * Fast approximations of the transcendental functions, for the per-pixel
+   * loops. They have no branch and no call, so that the loops can be
+   * vectorized. The error bounds are given for each function.
+   */
+  namespace fast {
+
+    namespace details {
+
+      // 1.5 * 2^52, x + magic has round(x) in its low bits, for |x| < 2^51
+      const double magic = 6755399441055744.0;
+
+      inline double from_bits(uint64_t bits) {
+        double x;
+        std::memcpy(&x, &bits, sizeof x);
+        return x;
+      }
+
+      inline uint64_t to_bits(double x) {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof bits);
+        return bits;
+      }
+
+      // sin(r) and cos(r) for |r| <= pi/4, Taylor series, error < 1e-11
+      inline double sin_poly(double r) {
+        double r2 = r * r;
+        return r * (1 + r2 * (-1.0 / 6 + r2 * (1.0 / 120 + r2 * (-1.0 / 5040 + r2 * (1.0 / 362880 + r2 * (-1.0 / 39916800))))));
+      }
+
+      inline double cos_poly(double r) {
+        double r2 = r * r;
+        return 1 + r2 * (-1.0 / 2 + r2 * (1.0 / 24 + r2 * (-1.0 / 720 + r2 * (1.0 / 40320 + r2 * (-1.0 / 3628800 + r2 * (1.0 / 479001600))))));
+      }
+
+      // x = r + q * pi/2 with |r| <= pi/4 (Cody-Waite reduction)
+      inline double reduce(double x, int64_t& q) {
+        const double pio2_hi = 1.57079632673412561417e+00;
+        const double pio2_lo = 6.07710050650619224932e-11;
+
+        double k = x * (2 / M_PI) + magic;
+        q = static_cast<int64_t>(to_bits(k) & 3);
+        k -= magic;
+        return (x - k * pio2_hi) - k * pio2_lo;
+      }
+
+    }
+
+    // 2^x, relative error < 1e-8, clamped to [2^-1022, 2^1023]
+    inline double exp2(double x) {
+      x = x < -1022.0 ? -1022.0 : (x > 1023.0 ? 1023.0 : x);
+
+      double k = x + details::magic;
+      double n = k - details::magic;
+      double t = (x - n) * M_LN2; // |t| <= ln(2) / 2
+
+      double p = 1 + t * (1 + t * (1.0 / 2 + t * (1.0 / 6 + t * (1.0 / 24 + t * (1.0 / 120 + t * (1.0 / 720 + t * (1.0 / 5040)))))));
+
+      // 2^n, built from the low bits of k
+      return p * details::from_bits((details::to_bits(k) + 1023) << 52);
+    }
+
+    // e^x, relative error < 1e-8, clamped like exp2
+    inline double exp(double x) {
+      return exp2(x * M_LOG2E);
+    }
+
+    // log2(x) for a normal x > 0, absolute error < 1e-10
+    inline double log2(double x) {
+      const double two52 = 4503599627370496.0; // 2^52
+
+      uint64_t bits = details::to_bits(x);
+      double e = details::from_bits((bits >> 52) | details::to_bits(two52)) - (two52 + 1023);
+      double m = details::from_bits((bits & UINT64_C(0x000FFFFFFFFFFFFF)) | UINT64_C(0x3FF0000000000000));
+
+      // m in [sqrt(1/2), sqrt(2))
+      bool big = m > M_SQRT2;
+      m = big ? m * 0.5 : m;
+      e = big ? e + 1 : e;
+
+      // ln(m) = 2 * atanh(t), |t| <= 0.172
+      double t = (m - 1) / (m + 1);
+      double t2 = t * t;
+      double ln = 2 * t * (1 + t2 * (1.0 / 3 + t2 * (1.0 / 5 + t2 * (1.0 / 7 + t2 * (1.0 / 9 + t2 * (1.0 / 11))))));
+
+      return e + ln * M_LOG2E;
+    }
+
+    // x^y for x >= 0, relative error < 1e-8 * (1 + |y * log2(x)|), and
+    // 0^0 = 1 like std::pow
+    inline double pow(double x, double y) {
+      double r = exp2(y * log2(x));
+      double zero = y == 0 ? 1.0 : 0.0;
+      return x > 0 ? r : zero;
+    }
+
+    // sin(x) and cos(x), absolute error < 1e-10 for |x| < 1e6
+    inline double sin(double x) {
+      int64_t q;
+      double r = details::reduce(x, q);
+      double s = details::sin_poly(r);
+      double c = details::cos_poly(r);
+      double v = (q & 1) ? c : s;
+      return (q & 2) ? -v : v;
+    }
+
+    inline double cos(double x) {
+      int64_t q;
+      double r = details::reduce(x, q);
+      double s = details::sin_poly(r);
+      double c = details::cos_poly(r);
+      double v = (q & 1) ? s : c;
+      return ((q + 1) & 2) ? -v : v;
+    }
+
+    // the cosine curve of curve.h, with the fast cosine
+    template<typename T>
+    T curve_cosine(T t) {
+      return (1 - fast::cos(M_PI * t)) * 0.5;
+    }
+
+  }
+
+}
+
+#endif // MM_FAST_MATH_H
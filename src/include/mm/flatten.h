@@ -22,8 +22,9 @@ namespace mm {
 
   class flatten {
   public:
-    flatten(double factor)
+    flatten(double factor, bool fast_math = false)
     : m_factor(factor)
+    , m_fast_math(fast_math)
     {
     }
 
@@ -31,6 +32,7 @@ namespace mm {
 
   private:
     double m_factor;
+    bool m_fast_math;
   };
 
 
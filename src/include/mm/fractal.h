@@ -16,6 +16,7 @@
 #ifndef MM_FRACTAL_H
 #define MM_FRACTAL_H
 
+#include <cstdint>
 #include <functional>
 
 #include <mm/heightmap.h>
@@ -27,23 +28,79 @@ namespace mm {
   public:
     typedef std::size_t size_type;
 
-    fractal(std::function<double(double,double)> noise, double scale, size_type octaves = 8, double lacunarity = 2.0, double persistence = 0.5)
+    // computes the noise at (x, y[i]) for i in [0, count)
+    typedef std::function<void(double, const double *, size_type, double *)> line_function;
+
+    // same, with the partial derivatives of the noise in the last two arrays
+    typedef std::function<void(double, const double *, size_type, double *, double *, double *)> derivative_function;
+
+    // what to do with the octaves whose lattice is finer than the pixels
+    enum class octave_limit {
+      none,     // all the octaves are computed
+      nyquist,  // the octaves with less than 2 pixels per lattice cell are skipped
+      fade,     // same as nyquist, and the octaves with less than 4 pixels per cell fade out
+    };
+
+    fractal(std::function<double(double,double)> noise, double scale, size_type octaves = 8, double lacunarity = 2.0, double persistence = 0.5, octave_limit limit = octave_limit::none);
+
+    fractal(line_function noise, double scale, size_type octaves = 8, double lacunarity = 2.0, double persistence = 0.5, octave_limit limit = octave_limit::none)
     : m_noise(noise)
     , m_scale(scale)
     , m_octaves(octaves)
     , m_lacunarity(lacunarity)
     , m_persistence(persistence)
+    , m_limit(limit)
     {
     }
 
+    // with the derivatives of the noise, for the analytic derivatives of the map
+    fractal(line_function noise, derivative_function derivatives, double scale, size_type octaves = 8, double lacunarity = 2.0, double persistence = 0.5, octave_limit limit = octave_limit::none)
+    : fractal(noise, scale, octaves, lacunarity, persistence, limit)
+    {
+      m_derivatives = derivatives;
+    }
+
     heightmap operator()(random_engine& engine, size_type width, size_type height) const;
 
+    // the map and its partial derivatives along x and y, in height per pixel,
+    // if the noise has derivatives
+    bool has_derivatives() const {
+      return static_cast<bool>(m_derivatives);
+    }
+
+    heightmap operator()(random_engine& engine, size_type width, size_type height, heightmap& dx, heightmap& dy) const;
+
+    // the chunk (cx, cy) of an unbounded map made of size x size chunks, the
+    // chunk (0, 0) is the same as a size x size map and the chunks are
+    // seamless (use a hash lattice to avoid repetitions)
+    heightmap generate_chunk(int64_t cx, int64_t cy, size_type size) const;
+
+    // the pixels [x0, x0 + width) x [y0, y0 + height) of the same unbounded
+    // map with chunks of size unit, sampled every 2^lod pixels. A sample is
+    // the value of the full resolution pixel without the octaves that are
+    // finer than the sampling (at least the nyquist limit when lod > 0).
+    heightmap sample_region(int64_t x0, int64_t y0, size_type width, size_type height, unsigned lod, size_type unit) const;
+
+    // the number of octaves that are actually computed for this size
+    size_type octaves(size_type width, size_type height) const;
+
   private:
-    std::function<double(double,double)> m_noise;
+    line_function m_noise;
+    derivative_function m_derivatives;
     double m_scale;
     size_type m_octaves;
     double m_lacunarity;
     double m_persistence;
+    octave_limit m_limit;
+
+    double step(size_type width, size_type height) const;
+    size_type octaves(double step, octave_limit limit) const;
+
+    // computes the pixels (x0 + stride * x, y0 + stride * y) for x in
+    // [0, width) and y in [0, height), where unit_width x unit_height pixels
+    // cover a square of side scale in the noise space, and the derivatives
+    // if dx and dy are not null
+    heightmap compute(int64_t x0, int64_t y0, size_type width, size_type height, size_type stride, size_type unit_width, size_type unit_height, octave_limit limit, heightmap *dx = nullptr, heightmap *dy = nullptr) const;
   };
 
 
@@ -24,8 +24,9 @@ namespace mm {
   public:
     typedef std::size_t size_type;
 
-    gaussize(double spread)
+    gaussize(double spread, bool fast_math = false)
     : m_spread(spread)
+    , m_fast_math(fast_math)
     {
     }
 
@@ -33,6 +34,7 @@ namespace mm {
 
   private:
     double m_spread;
+    bool m_fast_math;
   };
 
 }
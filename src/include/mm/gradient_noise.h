@@ -20,6 +20,7 @@
 #include <array>
 #include <functional>
 
+#include <mm/lattice.h>
 #include <mm/vector2.h>
 #include <mm/random.h>
 
@@ -27,12 +28,28 @@ namespace mm {
 
   class gradient_noise {
   public:
-    gradient_noise(random_engine& engine, std::function<double(double)> curve);
+    gradient_noise(random_engine& engine, std::function<double(double)> curve, lattice kind = lattice::permutation);
+
+    // with the derivative of the curve, for the analytic derivatives
+    gradient_noise(random_engine& engine, std::function<double(double)> curve, std::function<double(double)> curve_derivative, lattice kind = lattice::permutation);
 
     double operator()(double x, double y) const;
 
+    // the noise and its partial derivatives (needs the derivative of the curve)
+    double operator()(double x, double y, vector2& derivatives) const;
+
+    // computes the noise at (x, y[i]) for i in [0, count), the corners of
+    // a cell are computed once for consecutive values of y in the same cell
+    void line(double x, const double *y, std::size_t count, double *values) const;
+
+    // same, with the partial derivatives in dx[i] and dy[i]
+    void line(double x, const double *y, std::size_t count, double *values, double *dx, double *dy) const;
+
   private:
     std::function<double(double)> m_curve;
+    std::function<double(double)> m_curve_derivative;
+    lattice m_lattice;
+    uint64_t m_seed;
     std::array<vector2, 256> m_gradients;
     std::array<uint8_t, 256> m_perm;
 
@@ -41,6 +58,8 @@ namespace mm {
       return m_gradients.at(index);
     }
 
+    vector2 gradient(int64_t i, int64_t j) const;
+
   };
 
 }
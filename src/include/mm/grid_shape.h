@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_GRID_SHAPE_H
+#define MM_GRID_SHAPE_H
+
+#include <mm/planemap.h>
+
+namespace mm {
+
+  /**
+   * The shape of the grid of a subdivision generator (diamond-square or
+   * midpoint displacement).
+   *
+   * - square: one square of size 2^n+1 that covers the map, then cropped
+   * (legacy behaviour)
+   * - blocks: a rectangular grid of squares of size 2^n+1, so that the
+   * memory and the time scale with the area of the map
+   */
+  enum class grid_shape {
+    square,
+    blocks,
+  };
+
+  /**
+   * A grid of blocks: a lattice of (columns + 1) x (rows + 1) points
+   * spaced by step, step being a power of two.
+   */
+  struct block_grid {
+    typedef typename position::size_type size_type;
+
+    size_type step;
+    size_type columns;
+    size_type rows;
+
+    size_type width() const {
+      return columns * step + 1;
+    }
+
+    size_type height() const {
+      return rows * step + 1;
+    }
+  };
+
+  /**
+   * Compute the grid that covers a map of size width x height.
+   */
+  inline block_grid compute_block_grid(grid_shape shape, block_grid::size_type width, block_grid::size_type height) {
+    block_grid::size_type step = 1;
+
+    if (shape == grid_shape::square) {
+      while (step + 1 < height || step + 1 < width) {
+        step = step * 2;
+      }
+
+      return { step, 1, 1 };
+    }
+
+    // the largest block that fits in the smallest dimension
+    while (2 * step + 1 <= width && 2 * step + 1 <= height) {
+      step = step * 2;
+    }
+
+    block_grid::size_type columns = width > 1 ? (width - 1 + step - 1) / step : 1;
+    block_grid::size_type rows = height > 1 ? (height - 1 + step - 1) / step : 1;
+    return { step, columns, rows };
+  }
+
+}
+
+#endif // MM_GRID_SHAPE_H
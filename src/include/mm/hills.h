@@ -25,8 +25,8 @@ namespace mm {
   public:
     typedef std::size_t size_type;
 
-    hills(size_type count, double radius_min, double radius_max)
-    : m_count(count), m_radius_min(radius_min), m_radius_max(radius_max)
+    hills(size_type count, double radius_min, double radius_max, random_mode mode = random_mode::sequential)
+    : m_count(count), m_radius_min(radius_min), m_radius_max(radius_max), m_mode(mode)
     {
       // just in case
       if (m_radius_min > m_radius_max) {
@@ -40,7 +40,7 @@ namespace mm {
     size_type m_count;
     double m_radius_min;
     double m_radius_max;
-
+    random_mode m_mode;
   };
 
 
@@ -16,6 +16,7 @@
 #ifndef MM_HYDRAULIC_EROSION_H
 #define MM_HYDRAULIC_EROSION_H
 
+#include <mm/binarymap.h>
 #include <mm/heightmap.h>
 
 namespace mm {
@@ -24,12 +25,25 @@ namespace mm {
   public:
     typedef std::size_t size_type;
 
-    hydraulic_erosion(size_type iterations, double rain_amount, double solubility, double evaporation, double capacity)
-    : m_iterations(iterations), m_rain_amount(rain_amount), m_solubility(solubility), m_evaporation(evaporation), m_capacity(capacity)
+    hydraulic_erosion(size_type iterations, double rain_amount, double solubility, double evaporation, double capacity, double tolerance = 0.0)
+    : m_iterations(iterations), m_rain_amount(rain_amount), m_solubility(solubility), m_evaporation(evaporation), m_capacity(capacity), m_tolerance(tolerance)
     {
     }
 
-    heightmap operator()(const heightmap& src) const;
+    heightmap operator()(const heightmap& src) const {
+      size_type iterations;
+      return (*this)(src, binarymap(), iterations);
+    }
+
+    // stops when no cell changes more than the tolerance, and gives the
+    // number of computed iterations
+    heightmap operator()(const heightmap& src, size_type& iterations) const {
+      return (*this)(src, binarymap(), iterations);
+    }
+
+    // only the cells of the mask get rain and move water, an empty mask has
+    // all the cells
+    heightmap operator()(const heightmap& src, const binarymap& mask, size_type& iterations) const;
 
   private:
     size_type m_iterations;
@@ -37,6 +51,7 @@ namespace mm {
     double m_solubility;
     double m_evaporation;
     double m_capacity;
+    double m_tolerance;
 
   };
 
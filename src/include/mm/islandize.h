@@ -24,8 +24,9 @@ namespace mm {
   public:
     typedef std::size_t size_type;
 
-    islandize(double border)
+    islandize(double border, bool fast_math = false)
     : m_border(border)
+    , m_fast_math(fast_math)
     {
     }
 
@@ -33,6 +34,7 @@ namespace mm {
 
   private:
     double m_border;
+    bool m_fast_math;
   };
 
 
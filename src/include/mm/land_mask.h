@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_LAND_MASK_H
+#define MM_LAND_MASK_H
+
+#include <mm/binarymap.h>
+#include <mm/heightmap.h>
+
+namespace mm {
+
+  /**
+   * The cells above the sea level, and the cells of the sea at distance
+   * `margin` (or less) of them, e.g. to restrict a modifier to the land.
+   */
+  class land_mask {
+  public:
+    typedef std::size_t size_type;
+
+    land_mask(double sea_level, size_type margin = 0)
+    : m_sea_level(sea_level), m_margin(margin)
+    {
+    }
+
+    binarymap operator()(const heightmap& src) const;
+
+  private:
+    double m_sea_level;
+    size_type m_margin;
+  };
+
+}
+
+#endif // MM_LAND_MASK_H
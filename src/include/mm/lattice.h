@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_LATTICE_H
+#define MM_LATTICE_H
+
+#include <cstdint>
+
+#include <mm/vector2.h>
+
+namespace mm {
+
+  // how the noise functions get the random values of the lattice points
+  enum class lattice {
+    permutation,  // 256-entry permutation table, repeats every 256 units
+    hash,         // hash of the seed and the coordinates, never repeats
+  };
+
+  // 64 random bits for the lattice point (i, j), the mix is the finalizer
+  // of splitmix64 so there is no memory access at all
+  inline
+  uint64_t lattice_hash(uint64_t seed, int64_t i, int64_t j) {
+    uint64_t h = seed + static_cast<uint64_t>(i) * UINT64_C(0x9E3779B97F4A7C15) + static_cast<uint64_t>(j) * UINT64_C(0xC2B2AE3D27D4EB4F);
+    h = (h ^ (h >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    h = (h ^ (h >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return h ^ (h >> 31);
+  }
+
+  // a value in [0, 1) from a hash
+  inline
+  double lattice_value(uint64_t h) {
+    return static_cast<double>(h >> 11) * 0x1.0p-53;
+  }
+
+  // one of the 8 unit vectors along the axes and the diagonals from a hash
+  inline
+  vector2 lattice_gradient(uint64_t h) {
+    static constexpr double D = 0.70710678118654752440; // sqrt(2) / 2
+
+    unsigned k = static_cast<unsigned>(h >> 61);
+    double s = (k & 1) ? -1.0 : 1.0;
+
+    if (k & 4) {
+      double t = (k & 2) ? -1.0 : 1.0;
+      return { s * D, t * D };
+    }
+
+    if (k & 2) {
+      return { 0.0, s };
+    }
+
+    return { s, 0.0 };
+  }
+
+}
+
+#endif // MM_LATTICE_H
@@ -16,6 +16,7 @@
 #ifndef MM_MIDPOINT_DISPLACEMENT_H
 #define MM_MIDPOINT_DISPLACEMENT_H
 
+#include <mm/grid_shape.h>
 #include <mm/random.h>
 #include <mm/heightmap.h>
 
@@ -25,13 +26,13 @@ namespace mm {
   public:
     typedef typename position::size_type size_type;
 
-    midpoint_displacement(double val = 0.0)
-    : m_ne(val), m_nw(val), m_sw(val), m_se(val)
+    midpoint_displacement(double val = 0.0, random_mode mode = random_mode::sequential, grid_shape shape = grid_shape::square)
+    : m_ne(val), m_nw(val), m_sw(val), m_se(val), m_mode(mode), m_shape(shape)
     {
     }
 
-    midpoint_displacement(double ne, double nw, double sw, double se)
-    : m_ne(ne), m_nw(nw), m_sw(sw), m_se(se)
+    midpoint_displacement(double ne, double nw, double sw, double se, random_mode mode = random_mode::sequential, grid_shape shape = grid_shape::square)
+    : m_ne(ne), m_nw(nw), m_sw(sw), m_se(se), m_mode(mode), m_shape(shape)
     {
     }
 
@@ -42,6 +43,8 @@ namespace mm {
     double m_nw;
     double m_sw;
     double m_se;
+    random_mode m_mode;
+    grid_shape m_shape;
   };
 
 
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_MULTIRESOLUTION_H
+#define MM_MULTIRESOLUTION_H
+
+#include <functional>
+
+#include <mm/heightmap.h>
+
+namespace mm {
+
+  /**
+   * Coarse to fine scheduling of an iterative modifier: the map is
+   * downsampled `levels - 1` times by a factor 2, most of the iterations
+   * are computed on the coarsest map, then the changes are upsampled to
+   * the finer map and refined with fewer iterations, until the original
+   * size. The level l gets a share of the iterations proportional to 2^l.
+   *
+   * The step function computes some iterations on the map of a level, where
+   * a cell covers 2^level cells of the original map.
+   */
+  class multiresolution {
+  public:
+    typedef std::size_t size_type;
+    typedef std::function<heightmap(const heightmap&, size_type level, size_type iterations)> step_function;
+
+    multiresolution(size_type levels, size_type iterations, step_function step)
+    : m_levels(levels), m_iterations(iterations), m_step(step)
+    {
+    }
+
+    heightmap operator()(const heightmap& src) const;
+
+  private:
+    size_type m_levels;
+    size_type m_iterations;
+    step_function m_step;
+  };
+
+}
+
+#endif // MM_MULTIRESOLUTION_H
@@ -13,10 +13,67 @@
  * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
+#ifndef MM_RANDOM_H
+#define MM_RANDOM_H
+
+#include <cstdint>
 #include <random>
 
 namespace mm {
 
   typedef std::mt19937_64 random_engine;
 
+  // how a generator gets its random values
+  enum class random_mode {
+    sequential, // drawn one after the other from the random engine
+    counter,    // computed independently for each cell with a counter_random
+  };
+
+  // Philox4x32-10 counter-based generator, see "Parallel random numbers: as
+  // easy as 1, 2, 3" (Salmon et al., 2011). The random bits only depend on
+  // the key and the counter, so they can be computed in any order and on
+  // any thread.
+  class counter_random {
+  public:
+    explicit counter_random(uint64_t key)
+    : m_key0(static_cast<uint32_t>(key))
+    , m_key1(static_cast<uint32_t>(key >> 32))
+    {
+    }
+
+    // random bits for the counter (stage, i, j, n), where stage identifies
+    // the step of the algorithm, (i, j) the cell and n the value in the cell
+    uint64_t operator()(uint32_t stage, uint32_t i, uint32_t j, uint32_t n = 0) const {
+      uint32_t c0 = i, c1 = j, c2 = stage, c3 = n;
+      uint32_t k0 = m_key0, k1 = m_key1;
+
+      for (int r = 0; r < 10; ++r) {
+        uint64_t p0 = static_cast<uint64_t>(UINT32_C(0xD2511F53)) * c0;
+        uint64_t p1 = static_cast<uint64_t>(UINT32_C(0xCD9E8D57)) * c2;
+
+        c0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        c1 = static_cast<uint32_t>(p1);
+        c2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c3 = static_cast<uint32_t>(p0);
+
+        k0 += UINT32_C(0x9E3779B9);
+        k1 += UINT32_C(0xBB67AE85);
+      }
+
+      return (static_cast<uint64_t>(c0) << 32) | c1;
+    }
+
+    // a value in [min, max)
+    double uniform(double min, double max, uint32_t stage, uint32_t i, uint32_t j, uint32_t n = 0) const {
+      double u = static_cast<double>((*this)(stage, i, j, n) >> 11) * 0x1.0p-53;
+      return min + (max - min) * u;
+    }
+
+  private:
+    uint32_t m_key0;
+    uint32_t m_key1;
+  };
+
 }
+
+#endif // MM_RANDOM_H
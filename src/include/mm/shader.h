@@ -31,6 +31,10 @@ namespace mm {
 
     colormap operator()(const colormap& src, const heightmap& map) const;
 
+    // with the partial derivatives of the map (e.g. from a fractal), instead
+    // of the differences with the neighbours
+    colormap operator()(const colormap& src, const heightmap& map, const heightmap& dx, const heightmap& dy) const;
+
   private:
     double m_sea_level;
   };
@@ -20,6 +20,7 @@
 #include <array>
 #include <functional>
 
+#include <mm/lattice.h>
 #include <mm/vector2.h>
 #include <mm/random.h>
 
@@ -27,14 +28,19 @@ namespace mm {
 
   class simplex_noise {
   public:
-    simplex_noise(random_engine& engine);
+    simplex_noise(random_engine& engine, lattice kind = lattice::permutation);
 
     double operator()(double x, double y) const;
 
+    // the noise and its partial derivatives
+    double operator()(double x, double y, vector2& derivatives) const;
+
   private:
+    lattice m_lattice;
+    uint64_t m_seed;
     std::array<uint8_t, 256> m_perm;
 
-    const vector2& grid(uint8_t i, uint8_t j) const;
+    vector2 grid(int64_t i, int64_t j) const;
 
   };
 
@@ -16,6 +16,7 @@
 #ifndef MM_SMOOTH_H
 #define MM_SMOOTH_H
 
+#include <mm/binarymap.h>
 #include <mm/heightmap.h>
 
 namespace mm {
@@ -24,15 +25,29 @@ namespace mm {
   public:
     typedef std::size_t size_type;
 
-    smooth(size_type iterations)
-    : m_iterations(iterations)
+    smooth(size_type iterations, double tolerance = 0.0)
+    : m_iterations(iterations), m_tolerance(tolerance)
     {
     }
 
-    heightmap operator()(const heightmap& src) const;
+    heightmap operator()(const heightmap& src) const {
+      size_type iterations;
+      return (*this)(src, binarymap(), iterations);
+    }
+
+    // stops when no cell changes more than the tolerance, and gives the
+    // number of computed iterations
+    heightmap operator()(const heightmap& src, size_type& iterations) const {
+      return (*this)(src, binarymap(), iterations);
+    }
+
+    // only the cells of the mask are smoothed, an empty mask has all the
+    // cells
+    heightmap operator()(const heightmap& src, const binarymap& mask, size_type& iterations) const;
 
   private:
     size_type m_iterations;
+    double m_tolerance;
   };
 
 }
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_SPECTRAL_H
+#define MM_SPECTRAL_H
+
+#include <mm/heightmap.h>
+#include <mm/random.h>
+
+namespace mm {
+
+  /**
+   * Spectral synthesis: a white noise filtered in the frequency domain so
+   * that its power spectrum is 1/f^beta. The map is computed with one
+   * inverse FFT, whatever the number of scales, and it tiles seamlessly.
+   *
+   * - beta = 2: rough terrain
+   * - beta = 3: smooth terrain
+   */
+  class spectral {
+  public:
+    typedef std::size_t size_type;
+
+    spectral(double beta = 2.0)
+    : m_beta(beta)
+    {
+    }
+
+    heightmap operator()(random_engine& engine, size_type width, size_type height) const;
+
+  private:
+    double m_beta;
+  };
+
+}
+
+#endif // MM_SPECTRAL_H
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_STREAM_POWER_EROSION_H
+#define MM_STREAM_POWER_EROSION_H
+
+#include <mm/heightmap.h>
+
+namespace mm {
+
+  /**
+   * Fluvial erosion with the stream power law: the altitude h of a cell
+   * changes with dh/dt = U - K A^m S, where A is the drainage area of the
+   * cell and S the slope towards its receiver. Each iteration computes the
+   * receivers, sorts the cells from the border of the map to the top of the
+   * hills and solves the equation implicitly in this order (Braun & Willett),
+   * so the time step can be very large. The depressions are routed towards
+   * the border of the map, and the border is fixed. The erosion never
+   * raises a cell, even in a depression.
+   *
+   * The drainage area is a number of cells and the distances are in cells.
+   */
+  class stream_power_erosion {
+  public:
+    typedef std::size_t size_type;
+
+    stream_power_erosion(size_type iterations, double erosion, double time_step = 1.0, double area_exponent = 0.5, double uplift = 0.0)
+    : m_iterations(iterations), m_erosion(erosion), m_time_step(time_step), m_area_exponent(area_exponent), m_uplift(uplift)
+    {
+    }
+
+    heightmap operator()(const heightmap& src) const;
+
+  private:
+    size_type m_iterations;
+    double m_erosion;
+    double m_time_step;
+    double m_area_exponent;
+    double m_uplift;
+
+  };
+
+}
+
+#endif // MM_STREAM_POWER_EROSION_H
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_TEMPORAL_BLOCKING_H
+#define MM_TEMPORAL_BLOCKING_H
+
+#include <functional>
+
+#include <mm/heightmap.h>
+
+namespace mm {
+
+  /**
+   * Temporal blocking of an iterative modifier where an iteration only
+   * depends on the cells at distance `reach` (like the erosions and the
+   * smoothing): the map is divided in tiles that fit in the cache, and
+   * `depth` iterations are computed on each tile with a halo of
+   * `depth * reach` cells around it, before going to the next tile. The
+   * cells of the halo are computed twice, but the map is read from the
+   * memory once every `depth` iterations instead of every iteration. The
+   * tiles are computed in parallel, and the result is the same as the
+   * modifier on the whole map.
+   *
+   * The step function computes some iterations on a tile (with its halo),
+   * where the border of the tile is handled like the border of the map.
+   */
+  class temporal_blocking {
+  public:
+    typedef std::size_t size_type;
+    typedef std::function<heightmap(const heightmap&, size_type iterations)> step_function;
+
+    // the size of a tile, without the halo
+    static constexpr size_type tile_size = 256;
+
+    temporal_blocking(size_type iterations, size_type depth, size_type reach, step_function step)
+    : m_iterations(iterations), m_depth(depth), m_reach(reach), m_step(step)
+    {
+    }
+
+    heightmap operator()(const heightmap& src) const;
+
+  private:
+    size_type m_iterations;
+    size_type m_depth;
+    size_type m_reach;
+    step_function m_step;
+  };
+
+}
+
+#endif // MM_TEMPORAL_BLOCKING_H
@@ -16,6 +16,7 @@
 #ifndef MM_THERMAL_EROSION_H
 #define MM_THERMAL_EROSION_H
 
+#include <mm/binarymap.h>
 #include <mm/heightmap.h>
 
 namespace mm {
@@ -24,17 +25,31 @@ namespace mm {
   public:
     typedef std::size_t size_type;
 
-    thermal_erosion(size_type iterations, double talus, double fraction)
-    : m_iterations(iterations), m_talus(talus), m_fraction(fraction)
+    thermal_erosion(size_type iterations, double talus, double fraction, double tolerance = 0.0)
+    : m_iterations(iterations), m_talus(talus), m_fraction(fraction), m_tolerance(tolerance)
     {
     }
 
-    heightmap operator()(const heightmap& src) const;
+    heightmap operator()(const heightmap& src) const {
+      size_type iterations;
+      return (*this)(src, binarymap(), iterations);
+    }
+
+    // stops when no cell changes more than the tolerance, and gives the
+    // number of computed iterations
+    heightmap operator()(const heightmap& src, size_type& iterations) const {
+      return (*this)(src, binarymap(), iterations);
+    }
+
+    // only the cells of the mask give and receive material, an empty mask
+    // has all the cells
+    heightmap operator()(const heightmap& src, const binarymap& mask, size_type& iterations) const;
 
   private:
     size_type m_iterations;
     double m_talus;
     double m_fraction;
+    double m_tolerance;
   };
 
 
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef MM_THREAD_POOL_H
+#define MM_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mm {
+
+  class thread_pool {
+  public:
+    typedef std::size_t size_type;
+    typedef std::function<void(size_type, size_type)> range_function;
+
+    // a pool with the calling thread and threads - 1 workers, 0 means
+    // one thread per hardware thread
+    explicit thread_pool(size_type threads = 0);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    size_type size() const {
+      return m_workers.size() + 1;
+    }
+
+    // calls func(b, e) on disjoint ranges that cover [begin, end) and waits
+    // for all of them, a call from inside func is run in the calling thread
+    void parallel_for(size_type begin, size_type end, const range_function& func);
+
+  private:
+    struct job;
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_call_mutex;
+
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    bool m_stop;
+    uint64_t m_generation;
+    job *m_job;
+
+    void work();
+    void run(job& current);
+  };
+
+  // the pool used by the algorithms of the library
+  thread_pool& default_thread_pool();
+
+  // changes the number of threads of the default pool, must not be called
+  // while the default pool is in use
+  void set_thread_count(thread_pool::size_type threads);
+
+  inline
+  void parallel_for(thread_pool::size_type begin, thread_pool::size_type end, const thread_pool::range_function& func) {
+    default_thread_pool().parallel_for(begin, end, func);
+  }
+
+}
+
+#endif // MM_THREAD_POOL_H
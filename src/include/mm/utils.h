@@ -16,6 +16,10 @@
 #ifndef MM_UTILS_H
 #define MM_UTILS_H
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
 namespace mm {
 
   inline
@@ -40,6 +44,17 @@ namespace mm {
     return value;
   }
 
+  inline
+  double max_difference(const double *lhs, const double *rhs, std::size_t size) {
+    double result = 0.0;
+
+    for (std::size_t i = 0; i < size; ++i) {
+      result = std::max(result, std::abs(lhs[i] - rhs[i]));
+    }
+
+    return result;
+  }
+
 }
 
 #endif // MM_UTILS_H
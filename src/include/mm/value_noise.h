@@ -20,18 +20,25 @@
 #include <array>
 #include <functional>
 
+#include <mm/lattice.h>
 #include <mm/random.h>
 
 namespace mm {
 
   class value_noise {
   public:
-    value_noise(random_engine& engine, std::function<double(double)> curve);
+    value_noise(random_engine& engine, std::function<double(double)> curve, lattice kind = lattice::permutation);
 
     double operator()(double x, double y) const;
 
+    // computes the noise at (x, y[i]) for i in [0, count), the values of the
+    // cell are only fetched and interpolated again when y[i] leaves the cell
+    void line(double x, const double *y, std::size_t count, double *values) const;
+
   private:
     std::function<double(double)> m_curve;
+    lattice m_lattice;
+    uint64_t m_seed;
     std::array<double, 256> m_values;
     std::array<uint8_t, 256> m_perm;
 
@@ -40,6 +47,8 @@ namespace mm {
       return m_values.at(index);
     }
 
+    double value(int64_t i, int64_t j) const;
+
   };
 
 }
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <mm/active_set.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace mm {
+
+  active_set::active_set(size_type width, size_type height)
+  : active_set(width, height, binarymap())
+  {
+  }
+
+  active_set::active_set(size_type width, size_type height, const binarymap& mask)
+  : m_width(width)
+  , m_height(height)
+  , m_blocks((height + block_size - 1) / block_size)
+  , m_mask(width * m_blocks, 1)
+  , m_changed(width * m_blocks, 0)
+  , m_active(width * m_blocks, 0)
+  , m_source(width * m_blocks, 0)
+  , m_active_columns(width, 0)
+  , m_source_columns(width, 0)
+  {
+    if (mask.width() == width && mask.height() == height) {
+      for (size_type x = 0; x < m_width; ++x) {
+        const bool *column = &mask(x, 0);
+
+        for (size_type b = 0; b < m_blocks; ++b) {
+          size_type end = std::min((b + 1) * block_size, m_height);
+          m_mask[x * m_blocks + b] = std::find(column + b * block_size, column + end, true) != column + end;
+        }
+      }
+    }
+
+    m_active = m_mask;
+    compute_columns();
+  }
+
+  void active_set::compare(size_type x, size_type y_begin, size_type y_end, const double *before, const double *after) {
+    char *column = m_changed.data() + x * m_blocks;
+
+    for (size_type b = y_begin / block_size; b * block_size < y_end; ++b) {
+      size_type begin = std::max(y_begin, b * block_size);
+      size_type end = std::min(y_end, (b + 1) * block_size);
+
+      // the bits are compared, so that a -0.0 is not taken for a +0.0
+      column[b] = std::memcmp(before + begin, after + begin, (end - begin) * sizeof(double)) != 0;
+    }
+  }
+
+  void active_set::update() {
+    // a block is active if a block at distance 2 columns (and 1 block, as a
+    // block has at least 2 rows) changed, and if it is in the mask
+    for (size_type x = 0; x < m_width; ++x) {
+      size_type x_begin = (x >= 2) ? x - 2 : 0;
+      size_type x_end = std::min(x + 3, m_width);
+
+      for (size_type b = 0; b < m_blocks; ++b) {
+        size_type b_begin = (b >= 1) ? b - 1 : 0;
+        size_type b_end = std::min(b + 2, m_blocks);
+        char active = 0;
+
+        for (size_type i = x_begin; i < x_end && !active; ++i) {
+          for (size_type j = b_begin; j < b_end; ++j) {
+            active |= m_changed[i * m_blocks + j];
+          }
+        }
+
+        m_active[x * m_blocks + b] = active & m_mask[x * m_blocks + b];
+      }
+    }
+
+    compute_columns();
+    std::fill(m_changed.begin(), m_changed.end(), 0);
+  }
+
+  void active_set::compute_columns() {
+    // the columns with an active block
+    for (size_type x = 0; x < m_width; ++x) {
+      m_active_columns[x] = std::find(m_active.begin() + x * m_blocks, m_active.begin() + (x + 1) * m_blocks, 1) != m_active.begin() + (x + 1) * m_blocks;
+    }
+
+    // the sources of a column are the active blocks of the column and of
+    // its two neighbour columns
+    for (size_type x = 0; x < m_width; ++x) {
+      size_type x_begin = (x >= 1) ? x - 1 : 0;
+      size_type x_end = std::min(x + 2, m_width);
+      char any = 0;
+
+      for (size_type b = 0; b < m_blocks; ++b) {
+        char source = 0;
+
+        for (size_type i = x_begin; i < x_end; ++i) {
+          source |= m_active[i * m_blocks + b];
+        }
+
+        m_source[x * m_blocks + b] = source;
+        any |= source;
+      }
+
+      m_source_columns[x] = any;
+    }
+  }
+
+  active_set::size_type active_set::active_blocks() const {
+    return std::count(m_active.begin(), m_active.end(), 1);
+  }
+
+}
@@ -16,7 +16,9 @@
 #include <mm/cell_noise.h>
 
 #include <cassert>
+#include <cmath>
 #include <algorithm>
+#include <type_traits>
 
 namespace mm {
 
@@ -69,28 +71,155 @@ namespace mm {
       m_coeffs.resize(m_cells.size());
     }
 
+    // without any cell, the grid has one empty bucket
+    if (m_cells.empty()) {
+      m_grid_size = 1;
+      m_grid_min = { 0.0, 0.0 };
+      m_grid_step = 1.0;
+      m_bucket_start.assign(2, 0);
+      return;
+    }
+
+    // build the grid, with about two cells per bucket
+    m_grid_min = m_cells.front();
+    vector2 grid_max = m_cells.front();
+
+    for (auto& cell : m_cells) {
+      m_grid_min.x = std::min(m_grid_min.x, cell.x);
+      m_grid_min.y = std::min(m_grid_min.y, cell.y);
+      grid_max.x = std::max(grid_max.x, cell.x);
+      grid_max.y = std::max(grid_max.y, cell.y);
+    }
+
+    m_grid_size = static_cast<size_type>(std::ceil(std::sqrt(m_cells.size() / 2.0)));
+
+    if (m_grid_size == 0) {
+      m_grid_size = 1;
+    }
+
+    double extent = std::max(grid_max.x - m_grid_min.x, grid_max.y - m_grid_min.y);
+    m_grid_step = (extent > 0.0) ? extent / m_grid_size : 1.0;
+
+    std::vector<size_type> indices(m_cells.size());
+    m_bucket_start.assign(m_grid_size * m_grid_size + 1, 0);
+
+    for (size_type i = 0; i < m_cells.size(); ++i) {
+      auto& cell = m_cells[i];
+      size_type b = bucket_index(cell.x, m_grid_min.x) * m_grid_size + bucket_index(cell.y, m_grid_min.y);
+      indices[i] = b;
+      m_bucket_start[b + 1]++;
+    }
+
+    for (size_type b = 0; b < m_grid_size * m_grid_size; ++b) {
+      m_bucket_start[b + 1] += m_bucket_start[b];
+    }
+
+    std::vector<size_type> next(m_bucket_start.begin(), m_bucket_start.end() - 1);
+    m_buckets.resize(m_cells.size());
+
+    for (size_type i = 0; i < m_cells.size(); ++i) {
+      m_buckets[next[indices[i]]++] = m_cells[i];
+    }
+  }
+
+  auto cell_noise::bucket_index(double value, double min) const -> size_type {
+    double index = std::floor((value - min) / m_grid_step);
+
+    if (index < 0.0) {
+      return 0;
+    }
+
+    if (index >= m_grid_size) {
+      return m_grid_size - 1;
+    }
+
+    return static_cast<size_type>(index);
   }
 
-  double cell_noise::operator()(double x, double y) {
-    double rx = std::fmod(x, 1);
-    double ry = std::fmod(y, 1);
+  double cell_noise::operator()(double x, double y) const {
+    double rx = x - std::floor(x);
+    double ry = y - std::floor(y);
 
     auto size = m_coeffs.size();
 
+    if (size == 0) {
+      return 0.0;
+    }
+
     vector2 here{rx, ry};
 
-    std::partial_sort(m_cells.begin(), m_cells.begin() + size, m_cells.end(), [&here, this](const vector2& lhs, const vector2& rhs) {
-      return m_distance(here, lhs) < m_distance(here, rhs);
-    });
+    // the nearest distances, in increasing order
+    static constexpr size_type STACK_SIZE = 16;
+    double stack_nearest[STACK_SIZE];
+    std::vector<double> heap_nearest;
+    double *nearest = stack_nearest;
+
+    if (size > STACK_SIZE) {
+      heap_nearest.resize(size);
+      nearest = heap_nearest.data();
+    }
+
+    size_type found = 0;
+
+    typedef std::make_signed<size_type>::type signed_type;
+    signed_type grid_size = m_grid_size;
+    signed_type bx = bucket_index(rx, m_grid_min.x);
+    signed_type by = bucket_index(ry, m_grid_min.y);
+
+    auto visit_bucket = [&](signed_type i, signed_type j) {
+      if (i < 0 || i >= grid_size || j < 0 || j >= grid_size) {
+        return;
+      }
+
+      size_type b = i * grid_size + j;
+
+      for (size_type k = m_bucket_start[b]; k < m_bucket_start[b + 1]; ++k) {
+        double d = m_distance(here, m_buckets[k]);
+
+        if (found == size && d >= nearest[size - 1]) {
+          continue;
+        }
+
+        size_type pos = (found < size) ? found++ : size - 1;
+
+        while (pos > 0 && nearest[pos - 1] > d) {
+          nearest[pos] = nearest[pos - 1];
+          --pos;
+        }
+
+        nearest[pos] = d;
+      }
+    };
+
+    // visit the buckets ring by ring, the buckets of ring r+1 are at least
+    // at r steps from here (for the chebyshev distance)
+    visit_bucket(bx, by);
+
+    for (signed_type r = 1; r <= grid_size; ++r) {
+      if (found == size && nearest[size - 1] <= (r - 1) * m_grid_step) {
+        break;
+      }
+
+      for (signed_type i = bx - r; i <= bx + r; ++i) {
+        visit_bucket(i, by - r);
+        visit_bucket(i, by + r);
+      }
+
+      for (signed_type j = by - r + 1; j <= by + r - 1; ++j) {
+        visit_bucket(bx - r, j);
+        visit_bucket(bx + r, j);
+      }
+    }
+
+    assert(found == size);
 
     double value = 0.0;
 
     for (decltype(size) i = 0; i < size; ++i) {
-      value += m_coeffs[i] * m_distance(here, m_cells[i]);
+      value += m_coeffs[i] * nearest[i];
     }
 
     return value;
   }
 
-
 }
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <mm/chunk_cache.h>
+
+#include <algorithm>
+
+namespace mm {
+
+  chunk_cache::chunk_cache(chunk_function chunk, size_type capacity, size_type threads)
+  : m_chunk(chunk)
+  , m_capacity(capacity)
+  , m_next_id(0)
+  , m_stop(false)
+  {
+    threads = std::max(threads, size_type(1));
+
+    for (size_type i = 0; i < threads; ++i) {
+      m_workers.emplace_back(&chunk_cache::work, this);
+    }
+  }
+
+  chunk_cache::~chunk_cache() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers) {
+      worker.join();
+    }
+  }
+
+  auto chunk_cache::get(int64_t cx, int64_t cy) -> chunk_pointer {
+    key_type key(cx, cy);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(key);
+
+    if (it != m_entries.end()) {
+      touch(it->second);
+
+      // a queued chunk is not started yet, it is computed now
+      if (it->second.queued) {
+        promise_pointer promise = std::move(it->second.queued);
+        uint64_t id = it->second.id;
+        lock.unlock();
+        return compute(key, id, promise);
+      }
+
+      auto chunk = it->second.chunk;
+      lock.unlock();
+      return chunk.get();
+    }
+
+    auto promise = std::make_shared<std::promise<chunk_pointer>>();
+    uint64_t id = insert(key, promise).id;
+    evict();
+    lock.unlock();
+
+    return compute(key, id, promise);
+  }
+
+  void chunk_cache::prefetch(int64_t cx, int64_t cy, int64_t radius) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      for (int64_t i = cx - radius; i <= cx + radius; ++i) {
+        for (int64_t j = cy - radius; j <= cy + radius; ++j) {
+          key_type key(i, j);
+
+          if (m_entries.count(key) > 0) {
+            continue;
+          }
+
+          auto promise = std::make_shared<std::promise<chunk_pointer>>();
+          entry& e = insert(key, promise);
+          e.queued = promise;
+          m_queue.push_back(task{ key, e.id });
+        }
+      }
+
+      evict();
+    }
+
+    m_wake.notify_all();
+  }
+
+  auto chunk_cache::insert(const key_type& key, promise_pointer promise) -> entry& {
+    m_lru.push_front(key);
+    auto result = m_entries.emplace(key, entry{ promise->get_future().share(), m_lru.begin(), m_next_id++, nullptr });
+    return result.first->second;
+  }
+
+  auto chunk_cache::compute(const key_type& key, uint64_t id, promise_pointer promise) -> chunk_pointer {
+    try {
+      auto chunk = std::make_shared<const heightmap>(m_chunk(key.first, key.second));
+      promise->set_value(chunk);
+      return chunk;
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+
+      // do not keep the failure in the cache, the entry may have been
+      // dropped and replaced in the meantime
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_entries.find(key);
+
+      if (it != m_entries.end() && it->second.id == id) {
+        m_lru.erase(it->second.lru);
+        m_entries.erase(it);
+      }
+
+      throw;
+    }
+  }
+
+  void chunk_cache::touch(entry& e) {
+    m_lru.splice(m_lru.begin(), m_lru, e.lru);
+  }
+
+  void chunk_cache::evict() {
+    // the futures come from promises, so dropping a chunk that is still
+    // being computed does not wait, its result is just not kept
+    while (m_entries.size() > m_capacity) {
+      m_entries.erase(m_lru.back());
+      m_lru.pop_back();
+    }
+  }
+
+  void chunk_cache::work() {
+    for (;;) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+
+      if (m_stop) {
+        return;
+      }
+
+      task current = m_queue.front();
+      m_queue.pop_front();
+
+      // the chunk may have been dropped, or taken by get()
+      auto it = m_entries.find(current.key);
+
+      if (it == m_entries.end() || it->second.id != current.id || !it->second.queued) {
+        continue;
+      }
+
+      promise_pointer promise = std::move(it->second.queued);
+      lock.unlock();
+
+      try {
+        compute(current.key, current.id, promise);
+      } catch (...) {
+        // the failure is not kept, a later get() computes the chunk again
+      }
+    }
+  }
+
+}
@@ -15,20 +15,60 @@
  */
 #include <mm/diamond_square.h>
 
+#include <functional>
+
+#include <mm/thread_pool.h>
+
 namespace mm {
 
   typedef typename diamond_square::size_type size_type;
 
-  static void diamond(random_engine& engine, heightmap& map, size_type x, size_type y, size_type d) {
-    double value = (map(x - d, y - d) + map(x - d, y + d) + map(x + d, y - d) + map(x + d, y + d)) / 4;
+  namespace {
+
+    // the noise of the legacy algorithm, drawn in the order of the cells
+    class sequential_noise {
+    public:
+      sequential_noise(random_engine& engine)
+      : m_engine(engine)
+      {
+      }
+
+      double operator()(size_type, size_type, size_type d) {
+        std::uniform_real_distribution<double> dist(-static_cast<double>(d), static_cast<double>(d));
+        return dist(m_engine);
+      }
+
+    private:
+      random_engine& m_engine;
+    };
+
+    // the noise of a cell only depends on its position (each cell is
+    // computed exactly once)
+    class counter_noise {
+    public:
+      counter_noise(random_engine& engine)
+      : m_random(engine())
+      {
+      }
 
-    std::uniform_real_distribution<double> dist(-static_cast<double>(d), static_cast<double>(d));
-    double noise = dist(engine);
+      double operator()(size_type x, size_type y, size_type d) const {
+        return m_random.uniform(-static_cast<double>(d), static_cast<double>(d), 0, x, y);
+      }
+
+    private:
+      counter_random m_random;
+    };
 
-    map(x, y) = value + noise;
   }
 
-  static void square(random_engine& engine, heightmap& map, size_type x, size_type y, size_type d) {
+  template<typename Noise>
+  static void diamond(Noise& noise, heightmap& map, size_type x, size_type y, size_type d) {
+    double value = (map(x - d, y - d) + map(x - d, y + d) + map(x + d, y - d) + map(x + d, y + d)) / 4;
+    map(x, y) = value + noise(x, y, d);
+  }
+
+  template<typename Noise>
+  static void square(Noise& noise, heightmap& map, size_type x, size_type y, size_type d) {
     double value = 0.0;
     size_type n = 0;
 
@@ -53,57 +93,101 @@ namespace mm {
     }
 
     value = value / n;
+    map(x, y) = value + noise(x, y, d);
+  }
+
+  // calls func(x) for x = first, first + d, ... below end, the calls are
+  // spread over the threads of the default pool if parallel is true
+  static void for_each_column(bool parallel, size_type first, size_type end, size_type d, const std::function<void(size_type)>& func) {
+    size_type count = (end - first + d - 1) / d;
+
+    if (!parallel) {
+      for (size_type i = 0; i < count; ++i) {
+        func(first + i * d);
+      }
 
-    std::uniform_real_distribution<double> dist(-static_cast<double>(d), static_cast<double>(d));
-    double noise = dist(engine);
+      return;
+    }
 
-    map(x, y) = value + noise;
+    parallel_for(0, count, [&](size_type b, size_type e) {
+      for (size_type i = b; i < e; ++i) {
+        func(first + i * d);
+      }
+    });
   }
 
-  heightmap diamond_square::operator()(random_engine& engine, size_type width, size_type height) const {
-    size_type size = 1;
+  // set the points of the lattice of the grid: the corners get the values,
+  // the other points get the bilinear interpolation of the corners plus
+  // some noise
+  template<typename Noise>
+  static void initialize_lattice(Noise& noise, heightmap& map, const block_grid& grid, double nw, double ne, double se, double sw) {
+    for (size_type i = 0; i <= grid.columns; ++i) {
+      double t = static_cast<double>(i) / grid.columns;
+
+      for (size_type j = 0; j <= grid.rows; ++j) {
+        double u = static_cast<double>(j) / grid.rows;
+        size_type x = i * grid.step;
+        size_type y = j * grid.step;
+
+        double value = (1 - t) * ((1 - u) * nw + u * ne) + t * ((1 - u) * sw + u * se);
+        bool corner = (i == 0 || i == grid.columns) && (j == 0 || j == grid.rows);
 
-    while (size + 1 < height || size + 1 < width) {
-      size = size * 2;
+        map(x, y) = corner ? value : value + noise(x, y, grid.step);
+      }
     }
+  }
 
-    size_type d = size;
-    size = size + 1;
-    heightmap map(size, size);
+  template<typename Noise>
+  static heightmap generate(Noise noise, bool parallel, grid_shape shape, size_type width, size_type height, double nw, double ne, double se, double sw) {
+    block_grid grid = compute_block_grid(shape, width, height);
 
-    map(0, 0) = m_nw;
-    map(0, d) = m_ne;
-    map(d, 0) = m_sw;
-    map(d, d) = m_se;
+    size_type d = grid.step;
+    heightmap map(grid.width(), grid.height());
 
+    initialize_lattice(noise, map, grid, nw, ne, se, sw);
+
+    // in a level, all the cells of a pass only depend on the previous
+    // passes, so a pass can be computed in parallel
     while (d >= 2) {
       size_type d_2 = d / 2;
 
-      for (size_type x = d_2; x < map.width(); x += d) {
+      for_each_column(parallel, d_2, map.width(), d, [&](size_type x) {
         for (size_type y = d_2; y < map.height(); y += d) {
-          diamond(engine, map, x, y, d_2);
+          diamond(noise, map, x, y, d_2);
         }
-      }
+      });
 
-      for (size_type x = d_2; x < map.width(); x += d) {
+      for_each_column(parallel, d_2, map.width(), d, [&](size_type x) {
         for (size_type y = 0; y < map.height(); y += d) {
-          square(engine, map, x, y, d_2);
+          square(noise, map, x, y, d_2);
         }
-      }
+      });
 
-      for (size_type x = 0; x < map.width(); x += d) {
+      for_each_column(parallel, 0, map.width(), d, [&](size_type x) {
         for (size_type y = d_2; y < map.height(); y += d) {
-          square(engine, map, x, y, d_2);
+          square(noise, map, x, y, d_2);
         }
-      }
+      });
 
       d = d_2;
     }
 
-    size_type offset_x = (size - width) / 2;
-    size_type offset_y = (size - height) / 2;
+    if (map.width() == width && map.height() == height) {
+      return map;
+    }
+
+    size_type offset_x = (map.width() - width) / 2;
+    size_type offset_y = (map.height() - height) / 2;
 
     return map.submap(offset_x, offset_y, width, height);
   }
 
+  heightmap diamond_square::operator()(random_engine& engine, size_type width, size_type height) const {
+    if (m_mode == random_mode::counter) {
+      return generate(counter_noise(engine), true, m_shape, width, height, m_nw, m_ne, m_se, m_sw);
+    }
+
+    return generate(sequential_noise(engine), false, m_shape, width, height, m_nw, m_ne, m_se, m_sw);
+  }
+
 }
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <mm/droplet_erosion.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <mm/random.h>
+#include <mm/thread_pool.h>
+#include <mm/vector2.h>
+
+namespace mm {
+
+  // the cells around a droplet that are eroded, with a weight that
+  // decreases with the distance
+  struct droplet_erosion::brush {
+    struct cell {
+      int dx;
+      int dy;
+      double weight;
+    };
+
+    int radius;
+    std::vector<cell> cells;
+    double total;
+  };
+
+  namespace {
+
+    typedef droplet_erosion::size_type size_type;
+
+    // the altitude and the gradient at (x, y), interpolated in the cell
+    double altitude_at(const heightmap& map, double x, double y, vector2& gradient) {
+      size_type cx = static_cast<size_type>(x);
+      size_type cy = static_cast<size_type>(y);
+      double u = x - cx;
+      double v = y - cy;
+
+      double nw = map(cx, cy);
+      double ne = map(cx + 1, cy);
+      double sw = map(cx, cy + 1);
+      double se = map(cx + 1, cy + 1);
+
+      gradient.x = (ne - nw) * (1 - v) + (se - sw) * v;
+      gradient.y = (sw - nw) * (1 - u) + (se - ne) * u;
+
+      return nw * (1 - u) * (1 - v) + ne * u * (1 - v) + sw * (1 - u) * v + se * u * v;
+    }
+
+  }
+
+  void droplet_erosion::simulate(heightmap& map, const brush& erosion_brush, double x, double y) const {
+    int width = static_cast<int>(map.width());
+    int height = static_cast<int>(map.height());
+
+    vector2 direction = { 0.0, 0.0 };
+    double speed = 1.0;
+    double water = 1.0;
+    double sediment = 0.0;
+
+    for (size_type life = 0; life < m_lifetime; ++life) {
+      int cx = static_cast<int>(x);
+      int cy = static_cast<int>(y);
+      double u = x - cx;
+      double v = y - cy;
+
+      vector2 gradient;
+      double altitude = altitude_at(map, x, y, gradient);
+
+      // the droplet follows the slope, with some inertia
+      direction.x = direction.x * m_inertia - gradient.x * (1 - m_inertia);
+      direction.y = direction.y * m_inertia - gradient.y * (1 - m_inertia);
+
+      double length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+
+      if (length == 0.0) {
+        break;
+      }
+
+      direction.x /= length;
+      direction.y /= length;
+
+      x += direction.x;
+      y += direction.y;
+
+      if (x < 0 || y < 0 || x >= width - 1 || y >= height - 1) {
+        break;
+      }
+
+      double difference = altitude_at(map, x, y, gradient) - altitude;
+      double capacity = std::max(-difference * speed * water * m_capacity, m_min_capacity);
+
+      if (sediment > capacity || difference > 0) {
+        // deposit on the corners of the previous cell
+        double amount = (difference > 0) ? std::min(difference, sediment) : (sediment - capacity) * m_deposition;
+        sediment -= amount;
+
+        map(cx, cy) += amount * (1 - u) * (1 - v);
+        map(cx + 1, cy) += amount * u * (1 - v);
+        map(cx, cy + 1) += amount * (1 - u) * v;
+        map(cx + 1, cy + 1) += amount * u * v;
+      } else {
+        // erode around the previous cell, without digging under zero
+        double amount = std::min((capacity - sediment) * m_erosion, -difference);
+        int r = erosion_brush.radius;
+        double total = erosion_brush.total;
+        bool inside = cx >= r && cy >= r && cx + r < width && cy + r < height;
+
+        auto in_map = [&](const brush::cell& cell) {
+          return inside || (cx + cell.dx >= 0 && cx + cell.dx < width && cy + cell.dy >= 0 && cy + cell.dy < height);
+        };
+
+        if (!inside) {
+          total = 0.0;
+
+          for (auto& cell : erosion_brush.cells) {
+            if (in_map(cell)) {
+              total += cell.weight;
+            }
+          }
+        }
+
+        for (auto& cell : erosion_brush.cells) {
+          if (in_map(cell)) {
+            double& altitude_there = map(cx + cell.dx, cy + cell.dy);
+            double eroded = std::min(altitude_there, amount * cell.weight / total);
+            altitude_there -= eroded;
+            sediment += eroded;
+          }
+        }
+      }
+
+      // the droplet accelerates downhill
+      speed = std::sqrt(std::max(0.0, speed * speed - difference * m_gravity));
+      water *= (1 - m_evaporation);
+    }
+  }
+
+  heightmap droplet_erosion::operator()(const heightmap& src) const {
+    heightmap map(src);
+
+    size_type width = map.width();
+    size_type height = map.height();
+
+    if (width < 2 || height < 2 || m_radius == 0) {
+      return map;
+    }
+
+    brush erosion_brush;
+    erosion_brush.radius = static_cast<int>(m_radius);
+    erosion_brush.total = 0.0;
+
+    for (int dx = -erosion_brush.radius; dx <= erosion_brush.radius; ++dx) {
+      for (int dy = -erosion_brush.radius; dy <= erosion_brush.radius; ++dy) {
+        double weight = erosion_brush.radius - std::sqrt(dx * dx + dy * dy);
+
+        if (weight > 0) {
+          erosion_brush.cells.push_back({ dx, dy, weight });
+          erosion_brush.total += weight;
+        }
+      }
+    }
+
+    // a droplet moves one cell per step, and touches the cells around it
+    // up to the radius of the brush, so the droplets of two tiles that are
+    // separated by a tile never touch the same cells
+    size_type reach = m_lifetime + m_radius + 1;
+    size_type tile = 2 * reach;
+
+    // the droplets start in [0, width - 1) x [0, height - 1)
+    size_type area_width = width - 1;
+    size_type area_height = height - 1;
+    size_type columns = (area_width + tile - 1) / tile;
+    size_type rows = (area_height + tile - 1) / tile;
+
+    counter_random random(m_seed);
+
+    for (size_type color = 0; color < 4; ++color) {
+      std::vector<size_type> tiles;
+
+      for (size_type i = color % 2; i < columns; i += 2) {
+        for (size_type j = color / 2; j < rows; j += 2) {
+          tiles.push_back(i * rows + j);
+        }
+      }
+
+      parallel_for(0, tiles.size(), [&](size_type b, size_type e) {
+        for (size_type t = b; t < e; ++t) {
+          size_type index = tiles[t];
+          size_type i = index / rows;
+          size_type j = index % rows;
+
+          size_type x0 = i * tile;
+          size_type x1 = std::min(x0 + tile, area_width);
+          size_type y0 = j * tile;
+          size_type y1 = std::min(y0 + tile, area_height);
+
+          // the droplets are shared between the tiles according to their
+          // area, in the order of the tiles (column by column)
+          size_type before = x0 * area_height + (x1 - x0) * y0;
+          size_type after = before + (x1 - x0) * (y1 - y0);
+
+          double share = static_cast<double>(m_droplets) / (area_width * area_height);
+          size_type first = static_cast<size_type>(share * before);
+          size_type last = (after == area_width * area_height) ? m_droplets : static_cast<size_type>(share * after);
+
+          // the uniform draw can round up to the end of the tile, and the
+          // start must stay inside [0, width - 1) x [0, height - 1)
+          double x_max = std::nextafter(static_cast<double>(x1), 0.0);
+          double y_max = std::nextafter(static_cast<double>(y1), 0.0);
+
+          for (size_type k = first; k < last; ++k) {
+            uint32_t k0 = static_cast<uint32_t>(k);
+            uint32_t k1 = static_cast<uint32_t>(static_cast<uint64_t>(k) >> 32);
+            double x = std::min(random.uniform(x0, x1, 0, k0, k1, 0), x_max);
+            double y = std::min(random.uniform(y0, y1, 0, k0, k1, 1), y_max);
+            simulate(map, erosion_brush, x, y);
+          }
+        }
+      });
+    }
+
+    return map;
+  }
+
+}
@@ -15,43 +15,248 @@
  */
 #include <mm/fast_erosion.h>
 
+#include <algorithm>
+#include <vector>
+
+#include <mm/active_set.h>
+#include <mm/thread_pool.h>
+#include <mm/utils.h>
+
 namespace mm {
 
-  heightmap fast_erosion::operator()(const heightmap& src) const {
-    heightmap map(src);
-    heightmap material(size_only, src);
+  /*
+   * Each cell gives material to its steepest lower neighbour. Instead of
+   * scattering the material from each cell, each cell gathers the material
+   * from its neighbours, from the previous map to the next map (double
+   * buffering), so that the columns can be computed in parallel. The
+   * material given by the cells of a column is computed once in a column
+   * buffer: first the steepest descent of all the cells, with a loop per
+   * neighbour that can be vectorized, then the direction of the cells that
+   * give material. The neighbours are gathered in the order where they were
+   * scattered, so the result is the same for any number of threads.
+   *
+   * Only the active rows are computed: the cells whose neighbours at
+   * distance 2 did not change in the previous iteration do not change.
+   */
+
+  namespace {
+
+    typedef fast_erosion::size_type size_type;
+
+    // the neighbour (x + i, y + j) of a cell is k = (1 + i) * 3 + (1 + j)
+    constexpr size_type neighbours = 9;
+
+    // the material given by the cells of a column, with a zero cell at both
+    // ends: flow[k * (height + 2) + y + 1] is given by cell y to neighbour k,
+    // and amount[y + 1] is the material given by cell y
+    struct source_column {
+      std::vector<double> flow;
+      std::vector<double> amount;
+    };
+
+    // buffers for the cells of a column
+    struct descent_column {
+      std::vector<double> d_max;
+      std::vector<size_type> direction;
+    };
+
+    // the neighbour k of the cells y in [y_begin, y_end) of column x is
+    // there[y + k % 3 - 1], returns false if there is no such neighbour
+    bool neighbour(const heightmap& map, size_type x, size_type k, const double *& there, size_type& y_begin, size_type& y_end) {
+      size_type i = k / 3;
+      size_type j = k % 3;
+
+      if (k == 4 || x + i < 1 || x + i - 1 >= map.width()) {
+        return false;
+      }
+
+      there = &map(x + i - 1, 0);
+      y_begin = (j == 0) ? 1 : 0;
+      y_end = (j == 2) ? map.height() - 1 : map.height();
+      return true;
+    }
+
+    // computes the sources of the rows [r_begin, r_end) of column x
+    void compute_sources(const heightmap& map, size_type x, size_type r_begin, size_type r_end, double talus, double fraction, descent_column& descent, source_column& col) {
+      size_type height = map.height();
+      size_type stride = height + 2;
+
+      r_end = std::min(r_end, height);
+
+      const double *here = &map(x, 0);
+      double *d_max = descent.d_max.data();
+      size_type *direction = descent.direction.data();
+
+      // the steepest descent of the cells
+      std::fill(descent.d_max.begin() + r_begin, descent.d_max.begin() + r_end, 0.0);
+
+      for (size_type k = 0; k < neighbours; ++k) {
+        const double *there;
+        size_type y_begin, y_end;
 
-    for (size_type k = 0; k < m_iterations; ++k) {
-      // initialize material map
-      material.reset(0.0);
+        if (neighbour(map, x, k, there, y_begin, y_end)) {
+          y_begin = std::max(y_begin, r_begin);
+          y_end = std::min(y_end, r_end);
+
+          for (size_type y = y_begin; y < y_end; ++y) {
+            d_max[y] = std::max(d_max[y], here[y] - there[y + k % 3 - 1]);
+          }
+        }
+      }
+
+      // the first neighbour with the steepest descent, in the order of
+      // visit8neighbours
+      std::fill(descent.direction.begin() + r_begin, descent.direction.begin() + r_end, neighbours);
+
+      for (size_type k = neighbours; k-- > 0; ) {
+        const double *there;
+        size_type y_begin, y_end;
+
+        if (neighbour(map, x, k, there, y_begin, y_end)) {
+          y_begin = std::max(y_begin, r_begin);
+          y_end = std::min(y_end, r_end);
+
+          for (size_type y = y_begin; y < y_end; ++y) {
+            direction[y] = (here[y] - there[y + k % 3 - 1] == d_max[y]) ? k : direction[y];
+          }
+        }
+      }
+
+      for (size_type k = 0; k < neighbours; ++k) {
+        std::fill(col.flow.begin() + k * stride + r_begin + 1, col.flow.begin() + k * stride + r_end + 1, 0.0);
+      }
+
+      std::fill(col.amount.begin() + r_begin + 1, col.amount.begin() + r_end + 1, 0.0);
+
+      for (size_type y = r_begin; y < r_end; ++y) {
+        if (0 < d_max[y] && d_max[y] <= talus) {
+          double material = fraction * d_max[y];
+          col.amount[y + 1] = material;
+          col.flow[direction[y] * stride + y + 1] = material;
+        }
+      }
+    }
 
-      // compute material map
-      for (auto x : src.x_range()) {
-        for (auto y : src.y_range()) {
-          double altitude_difference_max = 0.0;
-          position pos_max = { x, y };
+    /*
+     * The gathered sum does not skip the neighbours that give nothing like
+     * the original kernel, but adding +0.0 instead gives the same result as
+     * the sum starts from +0.0 and can not become -0.0.
+     */
 
-          const double altitude_here = map(x, y);
+    // computes the next rows [y_begin, y_end) of column x
+    void gather(const heightmap& map, const source_column *cols[3], size_type x, size_type y_begin, size_type y_end, std::vector<double>& material, heightmap& next) {
+      size_type stride = map.height() + 2;
 
-          map.visit8neighbours(x, y, [altitude_here, &altitude_difference_max, &pos_max](position pos, double altitude_there) {
-            double altitude_difference = altitude_here - altitude_there;
-            if (altitude_difference > altitude_difference_max) {
-              altitude_difference_max = altitude_difference;
-              pos_max = pos;
+      std::fill(material.begin() + y_begin, material.begin() + y_end, 0.0);
+
+      for (size_type i = 0; i < 3; ++i) {
+        for (size_type j = 0; j < 3; ++j) {
+          if (i == 1 && j == 1) {
+            const double *amount = cols[1]->amount.data() + 1;
+
+            for (size_type y = y_begin; y < y_end; ++y) {
+              material[y] -= amount[y];
             }
+          } else {
+            // the direction from the source to the cell
+            size_type k = (2 - i) * 3 + (2 - j);
+            const double *flow = cols[i]->flow.data() + k * stride + j;
+
+            for (size_type y = y_begin; y < y_end; ++y) {
+              material[y] += flow[y];
+            }
+          }
+        }
+      }
+
+      const double *here = &map(x, 0);
+      double *there = &next(x, 0);
+
+      for (size_type y = y_begin; y < y_end; ++y) {
+        there[y] = here[y] + material[y];
+      }
+    }
+
+  }
+
+  heightmap fast_erosion::operator()(const heightmap& src, size_type& iterations) const {
+    heightmap map(src);
+    heightmap next(size_only, src);
+
+    size_type width = map.width();
+    size_type height = map.height();
+
+    iterations = 0;
+
+    if (width == 0 || height == 0) {
+      return map;
+    }
+
+    // with a tolerance, the largest change of each column
+    std::vector<double> changes(width, 0.0);
+    active_set active(width, height);
+
+    while (iterations < m_iterations) {
+      parallel_for(0, width, [&](size_type b, size_type e) {
+        // the sources of the columns x - 1, x and x + 1, and no source
+        // outside the map
+        source_column sources[3];
+        source_column none = { std::vector<double>(neighbours * (height + 2), 0.0), std::vector<double>(height + 2, 0.0) };
+        descent_column descent = { std::vector<double>(height), std::vector<size_type>(height) };
+        std::vector<double> material(height);
+
+        for (auto& col : sources) {
+          col.flow.resize(neighbours * (height + 2));
+          col.amount.resize(height + 2);
+        }
+
+        // the rows that give material to the active rows, one row around
+        // the source runs
+        auto sources_of = [&](size_type x) {
+          if (x >= width || !active.is_source(x)) {
+            return;
+          }
+
+          active.for_each_source_run(x, [&](size_type y_begin, size_type y_end) {
+            compute_sources(map, x, (y_begin >= 1 ? y_begin - 1 : 0), y_end + 1, m_talus, m_fraction, descent, sources[x % 3]);
           });
+        };
 
-          if (0 < altitude_difference_max && altitude_difference_max <= m_talus) {
-            material(x, y) -= m_fraction * altitude_difference_max;
-            material(pos_max) += m_fraction * altitude_difference_max;
+        for (size_type x = (b >= 1 ? b - 1 : 0); x <= b; ++x) {
+          sources_of(x);
+        }
+
+        for (size_type x = b; x < e; ++x) {
+          sources_of(x + 1);
+          changes[x] = 0.0;
+
+          if (!active.is_active(x)) {
+            continue;
           }
 
+          const source_column *cols[3] = {
+            x >= 1 ? &sources[(x - 1) % 3] : &none,
+            &sources[x % 3],
+            x + 1 < width ? &sources[(x + 1) % 3] : &none
+          };
+
+          active.for_each_active_run(x, [&](size_type y_begin, size_type y_end) {
+            gather(map, cols, x, y_begin, y_end, material, next);
+            active.compare(x, y_begin, y_end, &map(x, 0), &next(x, 0));
+
+            if (m_tolerance > 0) {
+              changes[x] = std::max(changes[x], max_difference(&next(x, y_begin), &map(x, y_begin), y_end - y_begin));
+            }
+          });
         }
-      }
+      });
+
+      active.update();
+      map.swap(next);
+      ++iterations;
 
-      // add material map to the map
-      for (auto fp : map.positions()) {
-        map(fp) += material(fp);
+      if (m_tolerance > 0 && *std::max_element(changes.begin(), changes.end()) < m_tolerance) {
+        break;
       }
     }
 
@@ -17,11 +17,23 @@
 
 #include <cmath>
 
+#include <mm/fast_math.h>
+
 namespace mm {
 
   heightmap flatten::operator()(const heightmap& src) const {
     heightmap map(src);
 
+    if (m_fast_math) {
+      for (heightmap::size_type x = 0; x < map.width(); ++x) {
+        for (heightmap::size_type y = 0; y < map.height(); ++y) {
+          map(x, y) = fast::pow(map(x, y), m_factor);
+        }
+      }
+
+      return map;
+    }
+
     for (heightmap::size_type x = 0; x < map.width(); ++x) {
       for (heightmap::size_type y = 0; y < map.height(); ++y) {
         map(x, y) = std::pow(map(x, y), m_factor);
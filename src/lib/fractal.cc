@@ -15,27 +15,168 @@
  */
 #include <mm/fractal.h>
 
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
 namespace mm {
 
+  fractal::fractal(std::function<double(double,double)> noise, double scale, size_type octaves, double lacunarity, double persistence, octave_limit limit)
+  : fractal([noise](double x, const double *y, size_type count, double *values) {
+      for (size_type i = 0; i < count; ++i) {
+        values[i] = noise(x, y[i]);
+      }
+    }, scale, octaves, lacunarity, persistence, limit)
+  {
+  }
+
+  static constexpr double NYQUIST_STEP = 0.5;
+
+  // the largest distance between two pixels in the noise space, at the first octave
+  double fractal::step(size_type width, size_type height) const {
+    return m_scale / static_cast<double>(std::min(width, height));
+  }
+
+  auto fractal::octaves(size_type width, size_type height) const -> size_type {
+    return octaves(step(width, height), m_limit);
+  }
+
+  auto fractal::octaves(double step, octave_limit limit) const -> size_type {
+    if (limit == octave_limit::none || m_lacunarity <= 1.0) {
+      return m_octaves;
+    }
+
+    size_type k = 0;
+
+    while (k < m_octaves && step <= NYQUIST_STEP) {
+      step *= m_lacunarity;
+      ++k;
+    }
+
+    return k;
+  }
+
   heightmap fractal::operator()(random_engine& engine, size_type width, size_type height) const {
+    return compute(0, 0, width, height, 1, width, height, m_limit);
+  }
+
+  heightmap fractal::operator()(random_engine&, size_type width, size_type height, heightmap& dx, heightmap& dy) const {
+    assert(has_derivatives());
+    dx = heightmap(width, height);
+    dy = heightmap(width, height);
+    return compute(0, 0, width, height, 1, width, height, m_limit, &dx, &dy);
+  }
+
+  heightmap fractal::generate_chunk(int64_t cx, int64_t cy, size_type size) const {
+    int64_t extent = static_cast<int64_t>(size);
+    return compute(cx * extent, cy * extent, size, size, 1, size, size, m_limit);
+  }
+
+  heightmap fractal::sample_region(int64_t x0, int64_t y0, size_type width, size_type height, unsigned lod, size_type unit) const {
+    size_type stride = size_type(1) << lod;
+
+    // the finer octaves are never visible at a coarser level
+    auto limit = m_limit;
+
+    if (lod > 0 && limit == octave_limit::none) {
+      limit = octave_limit::nyquist;
+    }
+
+    return compute(x0, y0, (width + stride - 1) / stride, (height + stride - 1) / stride, stride, unit, unit, limit);
+  }
+
+  heightmap fractal::compute(int64_t x0, int64_t y0, size_type width, size_type height, size_type stride, size_type unit_width, size_type unit_height, octave_limit limit, heightmap *dx, heightmap *dy) const {
     heightmap map(width, height);
 
+    const int64_t pixel_stride = static_cast<int64_t>(stride);
+
+    std::vector<double> yf(height);
+
+    for (size_type y = 0; y < height; ++y) {
+      yf[y] = static_cast<double>(y0 + static_cast<int64_t>(y) * pixel_stride) / static_cast<double>(unit_height) * m_scale;
+    }
+
+    std::vector<double> ys(height);
+    std::vector<double> noise(height);
+    std::vector<double> values(height);
+
+    // the derivatives, if needed: the noise at octave k is computed at
+    // (xf, yf) * frequency, and xf and yf are proportional to the pixel
+    // coordinates, hence the factors
+    const bool derivatives = (dx != nullptr && dy != nullptr);
+    const double factor_x = m_scale / static_cast<double>(unit_width);
+    const double factor_y = m_scale / static_cast<double>(unit_height);
+
+    std::vector<double> noise_dx(derivatives ? height : 0);
+    std::vector<double> noise_dy(derivatives ? height : 0);
+    std::vector<double> values_dx(derivatives ? height : 0);
+    std::vector<double> values_dy(derivatives ? height : 0);
+
+    const double pixel_step = step(unit_width, unit_height) * stride;
+    size_type octaves = this->octaves(pixel_step, limit);
+
+    // the weight of each octave, the octaves near the limit fade out linearly
+    std::vector<double> weights(octaves, 1.0);
+
+    if (limit == octave_limit::fade) {
+      double step = pixel_step;
+
+      for (auto& weight : weights) {
+        if (step > NYQUIST_STEP / 2) {
+          weight = (NYQUIST_STEP - step) / (NYQUIST_STEP / 2);
+        }
+
+        step *= m_lacunarity;
+      }
+    }
+
+    // a whole column is computed for each octave, so that the noise can
+    // reuse its lattice computations along the column
     for (size_type x = 0; x < width; ++x) {
-      for (size_type y = 0; y < height; ++y) {
-        double value = 0.0;
-        double frequency = 1.0;
-        double amplitude = 1.0;
+      double frequency = 1.0;
+      double amplitude = 1.0;
+
+      const double xf = static_cast<double>(x0 + static_cast<int64_t>(x) * pixel_stride) / static_cast<double>(unit_width) * m_scale;
+
+      std::fill(values.begin(), values.end(), 0.0);
+      std::fill(values_dx.begin(), values_dx.end(), 0.0);
+      std::fill(values_dy.begin(), values_dy.end(), 0.0);
+
+      for (size_type k = 0; k < octaves; ++k) {
+        for (size_type y = 0; y < height; ++y) {
+          ys[y] = yf[y] * frequency;
+        }
+
+        double weighted_amplitude = amplitude * weights[k];
+
+        if (derivatives) {
+          m_derivatives(xf * frequency, ys.data(), height, noise.data(), noise_dx.data(), noise_dy.data());
 
-        const double xf = static_cast<double>(x) / static_cast<double>(width) * m_scale;
-        const double yf = static_cast<double>(y) / static_cast<double>(height) * m_scale;
+          for (size_type y = 0; y < height; ++y) {
+            values_dx[y] += noise_dx[y] * weighted_amplitude * frequency * factor_x;
+            values_dy[y] += noise_dy[y] * weighted_amplitude * frequency * factor_y;
+          }
+        } else {
+          m_noise(xf * frequency, ys.data(), height, noise.data());
+        }
 
-        for (size_type k = 0; k < m_octaves; ++k) {
-          value += m_noise(xf * frequency, yf * frequency) * amplitude;
-          frequency *= m_lacunarity;
-          amplitude *= m_persistence;
+        for (size_type y = 0; y < height; ++y) {
+          values[y] += noise[y] * weighted_amplitude;
         }
 
-        map(x, y) = value;
+        frequency *= m_lacunarity;
+        amplitude *= m_persistence;
+      }
+
+      for (size_type y = 0; y < height; ++y) {
+        map(x, y) = values[y];
+      }
+
+      if (derivatives) {
+        for (size_type y = 0; y < height; ++y) {
+          (*dx)(x, y) = values_dx[y] * stride;
+          (*dy)(x, y) = values_dy[y] * stride;
+        }
       }
     }
 
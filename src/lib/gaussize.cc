@@ -16,6 +16,9 @@
 #include <mm/gaussize.h>
 
 #include <cmath>
+#include <vector>
+
+#include <mm/fast_math.h>
 
 namespace mm {
 
@@ -30,6 +33,28 @@ namespace mm {
 
     heightmap map(size_only, src);
 
+    if (m_fast_math) {
+      // the gaussian is separable: one exponential per column and per row
+      std::vector<double> gx(map.width());
+      std::vector<double> gy(map.height());
+
+      for (size_type x = 0; x < map.width(); ++x) {
+        gx[x] = fast::exp(-sqr(x - x0) / (2 * sqr(m_spread)));
+      }
+
+      for (size_type y = 0; y < map.height(); ++y) {
+        gy[y] = fast::exp(-sqr(y - y0) / (2 * sqr(m_spread)));
+      }
+
+      for (size_type x = 0; x < map.width(); ++x) {
+        for (size_type y = 0; y < map.height(); ++y) {
+          map(x, y) = src(x, y) * gx[x] * gy[y];
+        }
+      }
+
+      return map;
+    }
+
     for (size_type x = 0; x < map.width(); ++x) {
       for (size_type y = 0; y < map.height(); ++y) {
         map(x, y) = src(x,y) * std::exp(-(sqr(x - x0) / (2 * sqr(m_spread)) + sqr(y - y0) / (2 * sqr(m_spread))));
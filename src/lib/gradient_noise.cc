@@ -23,9 +23,16 @@
 namespace mm {
 
 
-  gradient_noise::gradient_noise(random_engine& engine, std::function<double(double)> curve)
+  gradient_noise::gradient_noise(random_engine& engine, std::function<double(double)> curve, lattice kind)
   : m_curve(curve)
+  , m_lattice(kind)
+  , m_seed(0)
   {
+    if (m_lattice == lattice::hash) {
+      m_seed = engine();
+      return;
+    }
+
     // generate gradients
     std::uniform_real_distribution<double> dist_grad(0.0, 2.0 * M_PI);
     for (auto& vec : m_gradients) {
@@ -51,21 +58,36 @@ namespace mm {
 
   }
 
+  gradient_noise::gradient_noise(random_engine& engine, std::function<double(double)> curve, std::function<double(double)> curve_derivative, lattice kind)
+  : gradient_noise(engine, curve, kind)
+  {
+    m_curve_derivative = curve_derivative;
+  }
 
+  vector2 gradient_noise::gradient(int64_t i, int64_t j) const {
+    if (m_lattice == lattice::hash) {
+      return lattice_gradient(lattice_hash(m_seed, i, j));
+    }
+
+    return grid(static_cast<uint8_t>(i), static_cast<uint8_t>(j));
+  }
 
   double gradient_noise::operator()(double x, double y) const {
-    uint8_t qx = static_cast<uint8_t>(std::fmod(x, 256));
-    double rx = std::fmod(x, 1);
-    assert(rx >= 0.0 && rx <= 1.0);
+    double fx = std::floor(x);
+    double rx = x - fx;
+    assert(rx >= 0.0 && rx < 1.0);
+
+    double fy = std::floor(y);
+    double ry = y - fy;
+    assert(ry >= 0.0 && ry < 1.0);
 
-    uint8_t qy = static_cast<uint8_t>(std::fmod(y, 256));
-    double ry = std::fmod(y, 1);
-    assert(ry >= 0.0 && ry <= 1.0);
+    int64_t qx = static_cast<int64_t>(fx);
+    int64_t qy = static_cast<int64_t>(fy);
 
-    double nw = dot(grid(qx    , qy    ), {rx      , ry      });
-    double ne = dot(grid(qx + 1, qy    ), {rx - 1.0, ry      });
-    double sw = dot(grid(qx    , qy + 1), {rx      , ry - 1.0});
-    double se = dot(grid(qx + 1, qy + 1), {rx - 1.0, ry - 1.0});
+    double nw = dot(gradient(qx    , qy    ), {rx      , ry      });
+    double ne = dot(gradient(qx + 1, qy    ), {rx - 1.0, ry      });
+    double sw = dot(gradient(qx    , qy + 1), {rx      , ry - 1.0});
+    double se = dot(gradient(qx + 1, qy + 1), {rx - 1.0, ry - 1.0});
 
     double n = lerp(nw, ne, m_curve(rx));
     double s = lerp(sw, se, m_curve(rx));
@@ -73,4 +95,124 @@ namespace mm {
     return lerp(n, s, m_curve(ry));
   }
 
+  double gradient_noise::operator()(double x, double y, vector2& derivatives) const {
+    double dx;
+    double dy;
+    double value;
+    line(x, &y, 1, &value, &dx, &dy);
+    derivatives = { dx, dy };
+    return value;
+  }
+
+  namespace {
+
+    // the gradients of the corners of a cell, and their dot products with
+    // the position in the cell
+    struct cell_corners {
+      vector2 gnw, gne, gsw, gse;
+      double nw, ne, sw, se;
+    };
+
+    // walks the line at x = qx + rx, the corners of a cell are computed once
+    // for consecutive values of y in the same cell, and func(i, corners, ry)
+    // is called for each y[i]
+    template<typename Gradient, typename Function>
+    void walk_line(Gradient gradient, int64_t qx, double rx, const double *y, std::size_t count, Function func) {
+      double cell = 0.0;
+      cell_corners c = { { 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }, 0.0, 0.0, 0.0, 0.0 };
+
+      // the products of the gradients of the current cell with rx
+      double pnw = 0.0, pne = 0.0, psw = 0.0, pse = 0.0;
+
+      for (std::size_t i = 0; i < count; ++i) {
+        double fy = std::floor(y[i]);
+
+        if (i == 0 || fy != cell) {
+          cell = fy;
+
+          int64_t qy = static_cast<int64_t>(fy);
+          c.gnw = gradient(qx    , qy    );
+          c.gne = gradient(qx + 1, qy    );
+          c.gsw = gradient(qx    , qy + 1);
+          c.gse = gradient(qx + 1, qy + 1);
+
+          pnw = c.gnw.x * rx;
+          pne = c.gne.x * (rx - 1.0);
+          psw = c.gsw.x * rx;
+          pse = c.gse.x * (rx - 1.0);
+        }
+
+        double ry = y[i] - fy;
+        assert(ry >= 0.0 && ry < 1.0);
+
+        c.nw = pnw + c.gnw.y * ry;
+        c.ne = pne + c.gne.y * ry;
+        c.sw = psw + c.gsw.y * (ry - 1.0);
+        c.se = pse + c.gse.y * (ry - 1.0);
+
+        func(i, c, ry);
+      }
+    }
+
+  }
+
+  void gradient_noise::line(double x, const double *y, std::size_t count, double *values) const {
+    double fx = std::floor(x);
+    double rx = x - fx;
+    assert(rx >= 0.0 && rx < 1.0);
+
+    int64_t qx = static_cast<int64_t>(fx);
+    double cx = m_curve(rx);
+
+    auto gradient = [this](int64_t i, int64_t j) {
+      return this->gradient(i, j);
+    };
+
+    walk_line(gradient, qx, rx, y, count, [&](std::size_t i, const cell_corners& c, double ry) {
+      double n = lerp(c.nw, c.ne, cx);
+      double s = lerp(c.sw, c.se, cx);
+
+      values[i] = lerp(n, s, m_curve(ry));
+    });
+  }
+
+  /*
+   * with v = lerp(n, s, c(ry)), n = lerp(nw, ne, c(rx)), s = lerp(sw, se, c(rx))
+   * and nw = dot(gnw, {rx, ry}) (and so on), the derivatives are:
+   *
+   * dv/dx = lerp(dn/dx, ds/dx, c(ry)) with dn/dx = lerp(gnw.x, gne.x, c(rx)) + (ne - nw) * c'(rx)
+   * dv/dy = lerp(dn/dy, ds/dy, c(ry)) + (s - n) * c'(ry) with dn/dy = lerp(gnw.y, gne.y, c(rx))
+   */
+  void gradient_noise::line(double x, const double *y, std::size_t count, double *values, double *dx, double *dy) const {
+    assert(m_curve_derivative);
+
+    double fx = std::floor(x);
+    double rx = x - fx;
+    assert(rx >= 0.0 && rx < 1.0);
+
+    int64_t qx = static_cast<int64_t>(fx);
+    double cx = m_curve(rx);
+    double dcx = m_curve_derivative(rx);
+
+    auto gradient = [this](int64_t i, int64_t j) {
+      return this->gradient(i, j);
+    };
+
+    walk_line(gradient, qx, rx, y, count, [&](std::size_t i, const cell_corners& c, double ry) {
+      double n = lerp(c.nw, c.ne, cx);
+      double s = lerp(c.sw, c.se, cx);
+
+      double cy = m_curve(ry);
+      values[i] = lerp(n, s, cy);
+
+      double dn_dx = lerp(c.gnw.x, c.gne.x, cx) + (c.ne - c.nw) * dcx;
+      double ds_dx = lerp(c.gsw.x, c.gse.x, cx) + (c.se - c.sw) * dcx;
+      dx[i] = lerp(dn_dx, ds_dx, cy);
+
+      double dn_dy = lerp(c.gnw.y, c.gne.y, cx);
+      double ds_dy = lerp(c.gsw.y, c.gse.y, cx);
+      dy[i] = lerp(dn_dy, ds_dy, cy) + (s - n) * m_curve_derivative(ry);
+    });
+  }
+
 }
@@ -15,8 +15,78 @@
  */
 #include <mm/hills.h>
 
+#include <cmath>
+#include <vector>
+
+#include <mm/thread_pool.h>
+
 namespace mm {
 
+  typedef typename hills::size_type size_type;
+
+  namespace {
+
+    struct hill {
+      double x;
+      double y;
+      double radius2;
+      size_type imin;
+      size_type imax;
+      size_type jmin;
+      size_type jmax;
+    };
+
+    // the map is cut in tiles and each tile is computed by one thread
+    constexpr size_type TILE_SIZE = 128;
+
+  }
+
+  // add the hill to the column i, for jb <= j < je
+  static void splat_column(heightmap& map, const hill& h, size_type i, size_type jb, size_type je) {
+    double dx2 = (h.x - i) * (h.x - i);
+
+    if (h.radius2 - dx2 <= 0) {
+      return;
+    }
+
+    auto positive = [&](size_type j) {
+      return h.radius2 - (dx2 + (h.y - j) * (h.y - j)) > 0;
+    };
+
+    // estimate the span of the column, then adjust its ends with the exact
+    // test, so that the span is exactly the cells where the hill is positive
+    double half = std::sqrt(h.radius2 - dx2);
+    double lo = std::floor(h.y - half);
+    double hi = std::floor(h.y + half) + 1;
+
+    size_type jlo = (lo <= jb) ? jb : (lo >= je ? je : static_cast<size_type>(lo));
+    size_type jhi = (hi <= jb) ? jb : (hi >= je ? je : static_cast<size_type>(hi));
+
+    while (jlo > jb && positive(jlo - 1)) {
+      --jlo;
+    }
+
+    while (jlo < jhi && !positive(jlo)) {
+      ++jlo;
+    }
+
+    if (jhi < jlo) {
+      jhi = jlo;
+    }
+
+    while (jhi < je && positive(jhi)) {
+      ++jhi;
+    }
+
+    while (jhi > jlo && !positive(jhi - 1)) {
+      --jhi;
+    }
+
+    for (size_type j = jlo; j < jhi; ++j) {
+      map(i, j) += h.radius2 - (dx2 + (h.y - j) * (h.y - j));
+    }
+  }
+
   heightmap hills::operator()(random_engine& engine, size_type width, size_type height) const {
     heightmap map(width, height, 0.0);
 
@@ -24,38 +94,85 @@ namespace mm {
 
     std::uniform_real_distribution<double> dist_radius(m_radius_min * size, m_radius_max * size);
 
+    // in counter mode, the hill k only depends on k
+    counter_random random(m_mode == random_mode::counter ? engine() : 0);
+
+    auto draw = [&](std::uniform_real_distribution<double>& dist, size_type k, uint32_t n) {
+      if (m_mode == random_mode::counter) {
+        return random.uniform(dist.a(), dist.b(), 0, static_cast<uint32_t>(k), static_cast<uint32_t>(static_cast<uint64_t>(k) >> 32), n);
+      }
+
+      return dist(engine);
+    };
+
+    std::vector<hill> all;
+    all.reserve(m_count);
+
     for (size_type k = 0; k < m_count; ++k) {
-      double radius = dist_radius(engine);
-      double radius2 = radius * radius;
+      hill h;
+
+      double radius = draw(dist_radius, k, 0);
+      h.radius2 = radius * radius;
 
       std::uniform_real_distribution<double> dist_x(-radius / 2, width + radius / 2);
-      double x = dist_x(engine);
-      double xmin = x - radius - 1;
-      double xmax = x + radius + 1;
+      h.x = draw(dist_x, k, 1);
+      double xmin = h.x - radius - 1;
+      double xmax = h.x + radius + 1;
 
-      size_type imin = (xmin < 0) ? 0 : static_cast<size_type>(xmin);
-      size_type imax = (xmax >= width) ? width : static_cast<size_type>(xmax);
+      h.imin = (xmin < 0) ? 0 : static_cast<size_type>(xmin);
+      h.imax = (xmax >= width) ? width : static_cast<size_type>(xmax);
 
       std::uniform_real_distribution<double> dist_y(-radius / 2, height + radius / 2);
-      double y = dist_y(engine);
-      double ymin = y - radius - 1;
-      double ymax = y + radius + 1;
+      h.y = draw(dist_y, k, 2);
+      double ymin = h.y - radius - 1;
+      double ymax = h.y + radius + 1;
 
-      size_type jmin = (ymin < 0) ? 0 : static_cast<size_type>(ymin);
-      size_type jmax = (ymax >= height) ? height : static_cast<size_type>(ymax);
+      h.jmin = (ymin < 0) ? 0 : static_cast<size_type>(ymin);
+      h.jmax = (ymax >= height) ? height : static_cast<size_type>(ymax);
 
-      for (size_type i = imin; i < imax; ++i) {
-        for (size_type j = jmin; j < jmax; ++j) {
-          double distance2 = (x - i) * (x - i) + (y - j) * (y - j);
-          double value2 = radius2 - distance2;
+      all.push_back(h);
+    }
 
-          if (value2 > 0) {
-            map.at(i, j) += value2;
-          }
+    // bin the hills by tile, in the order of the hills, so that each cell
+    // gets the sum of the hills in the same order as a serial computation
+    size_type tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    size_type tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    std::vector<std::vector<size_type>> bins(tiles_x * tiles_y);
+
+    for (size_type k = 0; k < all.size(); ++k) {
+      const hill& h = all[k];
+
+      if (h.imin >= h.imax || h.jmin >= h.jmax) {
+        continue;
+      }
+
+      for (size_type tx = h.imin / TILE_SIZE; tx <= (h.imax - 1) / TILE_SIZE; ++tx) {
+        for (size_type ty = h.jmin / TILE_SIZE; ty <= (h.jmax - 1) / TILE_SIZE; ++ty) {
+          bins[tx * tiles_y + ty].push_back(k);
         }
       }
     }
 
+    parallel_for(0, bins.size(), [&](size_type begin, size_type end) {
+      for (size_type t = begin; t < end; ++t) {
+        size_type tx = t / tiles_y;
+        size_type ty = t % tiles_y;
+
+        size_type ib = tx * TILE_SIZE;
+        size_type ie = std::min(ib + TILE_SIZE, width);
+        size_type jb = ty * TILE_SIZE;
+        size_type je = std::min(jb + TILE_SIZE, height);
+
+        for (size_type k : bins[t]) {
+          const hill& h = all[k];
+
+          for (size_type i = std::max(ib, h.imin); i < std::min(ie, h.imax); ++i) {
+            splat_column(map, h, i, std::max(jb, h.jmin), std::min(je, h.jmax));
+          }
+        }
+      }
+    });
+
     return map;
   }
 
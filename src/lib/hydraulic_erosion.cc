@@ -16,126 +16,295 @@
 #include <mm/hydraulic_erosion.h>
 
 #include <algorithm>
+#include <vector>
+
+#include <mm/active_set.h>
+#include <mm/thread_pool.h>
+#include <mm/utils.h>
 
 namespace mm {
 
-  heightmap hydraulic_erosion::operator()(const heightmap& src) const {
-    heightmap water_map(size_only, src);
-    heightmap water_diff(size_only, src);
+  /*
+   * An iteration is computed in a single sweep over the columns, from the
+   * state of the previous iteration to the next state (double buffering).
+   * For each column, the rain and the dissolution are applied to a copy of
+   * the column, then the water and the material of the column are
+   * transported to the diffs of the neighbour columns, and the column before
+   * is complete: its diffs and the evaporation give its next state. Only the
+   * last three columns are kept. The columns are visited in the same order
+   * as the original kernel, so the result is the same.
+   *
+   * With a mask, only the blocks of rows of the active set are computed, and
+   * the cells outside the mask do not change: they do not get rain, and the
+   * water that goes to them is lost.
+   */
 
-    heightmap material_map(size_only, src);
-    heightmap material_diff(size_only, src);
+  namespace {
 
-    heightmap map(src);
+    typedef hydraulic_erosion::size_type size_type;
 
-    double d[3][3];
+    struct state {
+      heightmap map;
+      heightmap water;
+      heightmap material;
+    };
 
-    for (size_type k = 0; k < m_iterations; ++k) {
+    struct parameters {
+      double rain_amount;
+      double solubility;
+      double evaporation;
+      double capacity;
+    };
 
-      // 1. appearance of new water
-      for (size_type x = 0; x < water_map.width(); ++x) {
-        for (size_type y = 0; y < water_map.height(); ++y) {
-          water_map(x, y) += m_rain_amount;
-        }
-      }
+    // a column after the rain and the dissolution
+    struct dissolved_column {
+      std::vector<double> map;
+      std::vector<double> water;
+      std::vector<double> material;
+      std::vector<double> altitude;
+    };
 
-      // 2. water erosion of the terrain
-      for (size_type x = 0; x < water_map.width(); ++x) {
-        for (size_type y = 0; y < water_map.height(); ++y) {
-          double material = m_solubility * water_map(x, y);
-          map(x, y) -= material;
-          material_map(x, y) += material;
-        }
-      }
+    // the transported water and material of a column
+    struct diff_column {
+      std::vector<double> water;
+      std::vector<double> material;
+    };
 
-      // 3. transportation of water
-      for (size_type x = 1; x < water_diff.width() - 1; ++x) {
-        for (size_type y = 1; y < water_diff.height() - 1; ++y) {
-          water_diff(x, y) = 0.0;
-        }
+    void dissolve(const parameters& params, const state& current, size_type x, size_type y_begin, size_type y_end, dissolved_column& col) {
+      const double *map = &current.map(x, 0);
+      const double *water = &current.water(x, 0);
+      const double *material = &current.material(x, 0);
+
+      for (size_type y = y_begin; y < y_end; ++y) {
+        double w = water[y] + params.rain_amount;
+        double m = params.solubility * w;
+        col.map[y] = map[y] - m;
+        col.water[y] = w;
+        col.material[y] = material[y] + m;
+        col.altitude[y] = col.map[y] + col.water[y];
       }
+    }
 
-      for (size_type x = 1; x < material_diff.width() - 1; ++x) {
-        for (size_type y = 1; y < material_diff.height() - 1; ++y) {
-          material_diff(x, y) = 0.0;
+    void transport(const dissolved_column *cols[3], diff_column *diffs[3], const bool *mask, size_type y_begin, size_type y_end) {
+      const dissolved_column& here = *cols[1];
+      diff_column& here_diff = *diffs[1];
+
+      for (size_type y = y_begin; y < y_end; ++y) {
+        if (mask != nullptr && !mask[y]) {
+          continue;
         }
-      }
 
-      for (size_type x = 1; x < map.width() - 1; ++x) {
-        for (size_type y = 1; y < map.height() - 1; ++y) {
-          double d_total = 0.0;
-          double a_total = 0.0;
-          double alt = map(x, y) + water_map(x, y);
-          size_type n = 0;
-
-          for (int i = -1; i <= 1; ++i) {
-            for (int j = -1; j <= 1; ++j) {
-              double alt_local = map(x+i, y+j) + water_map(x+i, y+j);
-              double diff = alt - alt_local;
-              d[1+i][1+j] = diff;
-
-              if (diff > 0.0) {
-                d_total += diff;
-                a_total += alt_local;
-                n++;
-              }
+        double d[3][3];
+        double d_total = 0.0;
+        double a_total = 0.0;
+        double alt = here.altitude[y];
+        size_type n = 0;
+
+        for (size_type i = 0; i < 3; ++i) {
+          for (size_type j = 0; j < 3; ++j) {
+            double alt_local = cols[i]->altitude[y + j - 1];
+            double diff = alt - alt_local;
+            d[i][j] = diff;
+
+            if (diff > 0.0) {
+              d_total += diff;
+              a_total += alt_local;
+              n++;
             }
           }
+        }
 
-          if (n == 0) {
-            continue;
-          }
+        if (n == 0) {
+          continue;
+        }
 
-          double a_avg = a_total / n;
-          double da = std::min(water_map(x, y), alt - a_avg);
+        double a_avg = a_total / n;
+        double da = std::min(here.water[y], alt - a_avg);
 
-          for (int i = -1; i <= 1; ++i) {
-            for (int j = -1; j <= 1; ++j) {
-              double diff = d[1+i][1+j];
+        for (size_type i = 0; i < 3; ++i) {
+          for (size_type j = 0; j < 3; ++j) {
+            double diff = d[i][j];
 
-              if (diff > 0.0) {
-                double dw = da * (diff / d_total);
-                water_diff(x+i, y+j) += dw;
-                water_diff(x, y) -= dw;
+            if (diff > 0.0) {
+              double dw = da * (diff / d_total);
+              diffs[i]->water[y + j - 1] += dw;
+              here_diff.water[y] -= dw;
 
-                double dm = material_map(x, y) * (dw / water_map(x, y));
-                material_diff(x+i, y+j) += dm;
-                material_diff(x, y) -= dm;
-              }
+              double dm = here.material[y] * (dw / here.water[y]);
+              diffs[i]->material[y + j - 1] += dm;
+              here_diff.material[y] -= dm;
             }
           }
         }
       }
+    }
+
+    void evaporate(const parameters& params, const dissolved_column& here, const diff_column& diff, bool interior, size_type x, size_type y_begin, size_type y_end, const bool *mask, const state& current, state& next) {
+      size_type height = next.map.height();
+      double *map = &next.map(x, 0);
+      double *water = &next.water(x, 0);
+      double *material = &next.material(x, 0);
+
+      for (size_type y = y_begin; y < y_end; ++y) {
+        if (mask != nullptr && !mask[y]) {
+          map[y] = current.map(x, y);
+          water[y] = current.water(x, y);
+          material[y] = current.material(x, y);
+          continue;
+        }
 
-      for (size_type x = 1; x < water_map.width() - 1; ++x) {
-        for (size_type y = 1; y < water_map.height() - 1; ++y) {
-          water_map(x, y) += water_diff(x, y);
+        double w = here.water[y];
+        double m = here.material[y];
+
+        if (interior && y >= 1 && y + 1 < height) {
+          w += diff.water[y];
+          m += diff.material[y];
         }
+
+        w = w * (1 - params.evaporation);
+
+        double m_max = params.capacity * w;
+        double dm = std::max(double(0), m - m_max);
+        water[y] = w;
+        material[y] = m - dm;
+        map[y] = here.map[y] + dm;
       }
+    }
 
-      for (size_type x = 1; x < material_map.width() - 1; ++x) {
-        for (size_type y = 1; y < material_map.height() - 1; ++y) {
-          material_map(x, y) += material_diff(x, y);
+    // computes the next state of the active rows of the columns in [b, e),
+    // and the largest change of the map in each column if needed
+    void sweep(const parameters& params, const state& current, state& next, const active_set& active, const binarymap& mask, size_type b, size_type e, std::vector<double> *changes) {
+      size_type width = current.map.width();
+      size_type height = current.map.height();
+      bool masked = mask.width() == width && mask.height() == height;
+
+      auto interior = [width](size_type x) {
+        return x >= 1 && x + 1 < width;
+      };
+
+      auto mask_of = [&](size_type x) {
+        return masked ? &mask(x, 0) : nullptr;
+      };
+
+      dissolved_column dissolved[3];
+      diff_column diffs[3];
+
+      for (auto& col : dissolved) {
+        col.map.resize(height);
+        col.water.resize(height);
+        col.material.resize(height);
+        col.altitude.resize(height);
+      }
+
+      for (auto& diff : diffs) {
+        diff.water.assign(height, 0.0);
+        diff.material.assign(height, 0.0);
+      }
+
+      // the rows that are read by the active rows, one row around the
+      // source runs
+      auto dissolve_column = [&](size_type x) {
+        if (!active.is_source(x)) {
+          return;
+        }
+
+        active.for_each_source_run(x, [&](size_type y_begin, size_type y_end) {
+          dissolve(params, current, x, (y_begin >= 1 ? y_begin - 1 : 0), std::min(y_end + 1, height), dissolved[x % 3]);
+        });
+      };
+
+      // the diffs are only written around the active rows
+      auto clear = [&](size_type x) {
+        if (active.is_source(x)) {
+          std::fill(diffs[x % 3].water.begin(), diffs[x % 3].water.end(), 0.0);
+          std::fill(diffs[x % 3].material.begin(), diffs[x % 3].material.end(), 0.0);
         }
+      };
+
+      auto finish = [&](size_type x) {
+        if (changes != nullptr) {
+          (*changes)[x] = 0.0;
+        }
+
+        active.for_each_active_run(x, [&](size_type y_begin, size_type y_end) {
+          evaporate(params, dissolved[x % 3], diffs[x % 3], interior(x), x, y_begin, y_end, mask_of(x), current, next);
+
+          if (changes != nullptr) {
+            (*changes)[x] = std::max((*changes)[x], max_difference(&next.map(x, y_begin), &current.map(x, y_begin), y_end - y_begin));
+          }
+        });
+
+        clear(x);
+      };
+
+      // the column before b is a source of b, but its own diffs are not complete
+      size_type first = (b >= 1 ? b - 1 : 0);
+      size_type last = std::min(e + 1, width);
+
+      if (first >= 1) {
+        dissolve_column(first - 1);
       }
 
-      // 4. evaporation of water
-      for (size_type x = 0; x < water_map.width(); ++x) {
-        for (size_type y = 0; y < water_map.height(); ++y) {
-          double water = water_map(x, y) * (1 - m_evaporation);
+      dissolve_column(first);
 
-          water_map(x, y) = water;
+      for (size_type x = first; x < last; ++x) {
+        if (x + 1 < width) {
+          dissolve_column(x + 1);
+        }
+
+        if (interior(x) && active.is_active(x)) {
+          const dissolved_column *cols[3] = { &dissolved[(x - 1) % 3], &dissolved[x % 3], &dissolved[(x + 1) % 3] };
+          diff_column *col_diffs[3] = { &diffs[(x - 1) % 3], &diffs[x % 3], &diffs[(x + 1) % 3] };
 
-          double m_max = m_capacity * water;
-          double dm = std::max(double(0), material_map(x, y) - m_max);
-          material_map(x, y) -= dm;
-          map(x, y) += dm;
+          active.for_each_active_run(x, [&](size_type y_begin, size_type y_end) {
+            transport(cols, col_diffs, mask_of(x), std::max(y_begin, size_type(1)), std::min(y_end, height - 1));
+          });
         }
+
+        if (x >= 1) {
+          if (x - 1 >= b) {
+            finish(x - 1);
+          } else {
+            clear(x - 1);
+          }
+        }
+      }
+
+      if (last == width && width - 1 >= b) {
+        finish(width - 1);
       }
+    }
+
+  }
 
+  heightmap hydraulic_erosion::operator()(const heightmap& src, const binarymap& mask, size_type& iterations) const {
+    parameters params = { m_rain_amount, m_solubility, m_evaporation, m_capacity };
+
+    // the cells that are never computed keep their state in both buffers
+    state current = { src, heightmap(size_only, src), heightmap(size_only, src) };
+    state next = { src, heightmap(size_only, src), heightmap(size_only, src) };
+
+    active_set active(src.width(), src.height(), mask);
+
+    std::vector<double> changes(src.width(), 0.0);
+    iterations = 0;
+
+    while (iterations < m_iterations) {
+      parallel_for(0, src.width(), [&](size_type b, size_type e) {
+        sweep(params, current, next, active, mask, b, e, m_tolerance > 0 ? &changes : nullptr);
+      });
+
+      current.map.swap(next.map);
+      current.water.swap(next.water);
+      current.material.swap(next.material);
+      ++iterations;
+
+      if (m_tolerance > 0 && *std::max_element(changes.begin(), changes.end()) < m_tolerance) {
+        break;
+      }
     }
 
-    return map;
+    return current.map;
   }
 
 }
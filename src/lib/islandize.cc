@@ -17,6 +17,8 @@
 
 #include <cmath>
 
+#include <mm/fast_math.h>
+
 namespace mm {
 
   heightmap islandize::operator()(const heightmap& src) const {
@@ -43,7 +45,8 @@ namespace mm {
         double coeff = coeffx * coeffy;
 
         if (coeff < 1.0) {
-          map(x, y) = map(x, y) * std::sin(std::sqrt(coeff) * M_PI / 2);
+          double angle = std::sqrt(coeff) * M_PI / 2;
+          map(x, y) = map(x, y) * (m_fast_math ? fast::sin(angle) : std::sin(angle));
         }
       }
     }
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <mm/land_mask.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace mm {
+
+  namespace {
+
+    typedef land_mask::size_type size_type;
+
+    // the distance to the nearest cell of the mask in a line of cells,
+    // saturated at margin + 1
+    void line_distance(std::vector<size_type>& distance, size_type margin) {
+      size_type size = distance.size();
+
+      for (size_type i = 1; i < size; ++i) {
+        distance[i] = std::min(distance[i], distance[i - 1] + 1);
+      }
+
+      for (size_type i = size - 1; i-- > 0; ) {
+        distance[i] = std::min(distance[i], distance[i + 1] + 1);
+      }
+
+      for (auto& d : distance) {
+        d = std::min(d, margin + 1);
+      }
+    }
+
+  }
+
+  binarymap land_mask::operator()(const heightmap& src) const {
+    size_type width = src.width();
+    size_type height = src.height();
+
+    binarymap map(size_only, src);
+
+    if (width == 0 || height == 0) {
+      return map;
+    }
+
+    // the dilation of a square is separable: first in the columns, then in
+    // the rows
+    std::vector<bool> near(width * height);
+    std::vector<size_type> distance(height);
+
+    for (size_type x = 0; x < width; ++x) {
+      for (size_type y = 0; y < height; ++y) {
+        distance[y] = (src(x, y) >= m_sea_level) ? 0 : m_margin + 1;
+      }
+
+      line_distance(distance, m_margin);
+
+      for (size_type y = 0; y < height; ++y) {
+        near[x * height + y] = distance[y] <= m_margin;
+      }
+    }
+
+    distance.resize(width);
+
+    for (size_type y = 0; y < height; ++y) {
+      for (size_type x = 0; x < width; ++x) {
+        distance[x] = near[x * height + y] ? 0 : m_margin + 1;
+      }
+
+      line_distance(distance, m_margin);
+
+      for (size_type x = 0; x < width; ++x) {
+        map(x, y) = distance[x] <= m_margin;
+      }
+    }
+
+    return map;
+  }
+
+}
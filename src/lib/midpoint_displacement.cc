@@ -15,65 +15,187 @@
  */
 #include <mm/midpoint_displacement.h>
 
+#include <mm/thread_pool.h>
+
 namespace mm {
 
-  heightmap midpoint_displacement::operator()(random_engine& engine, size_type width, size_type height) const {
-    size_type size = 1;
+  typedef typename midpoint_displacement::size_type size_type;
 
-    while (size + 1 < height || size + 1 < width) {
-      size = size * 2;
-    }
+  namespace {
 
-    size_type d = size;
-    size = size + 1;
-    heightmap map(size, size);
+    // the noise of the legacy algorithm, drawn in the order of the cells
+    class sequential_noise {
+    public:
+      sequential_noise(random_engine& engine)
+      : m_engine(engine)
+      , m_dist(0.0, 0.0)
+      {
+      }
 
-    map(0, 0) = m_ne;
-    map(0, d) = m_nw;
-    map(d, 0) = m_se;
-    map(d, d) = m_sw;
+      void set_level(size_type d) {
+        m_dist = std::uniform_real_distribution<double>(-static_cast<double>(d), static_cast<double>(d));
+      }
 
-    while (d >= 2) {
-      size_type d_2 = d / 2;
+      double operator()(size_type, size_type) {
+        return m_dist(m_engine);
+      }
+
+    private:
+      random_engine& m_engine;
+      std::uniform_real_distribution<double> m_dist;
+    };
+
+    // the noise of a cell only depends on its position, so an edge shared
+    // by two squares gets the same value from both squares
+    class counter_noise {
+    public:
+      counter_noise(random_engine& engine)
+      : m_random(engine())
+      , m_d(0.0)
+      {
+      }
+
+      void set_level(size_type d) {
+        m_d = static_cast<double>(d);
+      }
 
-      std::uniform_real_distribution<double> dist(-static_cast<double>(d), static_cast<double>(d));
+      double operator()(size_type x, size_type y) const {
+        return m_random.uniform(-m_d, m_d, 0, x, y);
+      }
+
+    private:
+      counter_random m_random;
+      double m_d;
+    };
+
+  }
 
-      for (size_type x = d_2; x < map.width(); x += d) {
+  // the legacy order: the center and the edges of each square, one square
+  // after the other (an edge shared by two squares is computed twice)
+  static void subdivide(sequential_noise& noise, heightmap& map, size_type d) {
+    size_type d_2 = d / 2;
+
+    for (size_type x = d_2; x < map.width(); x += d) {
+      for (size_type y = d_2; y < map.height(); y += d) {
+        double ne = map(x - d_2, y - d_2);
+        double nw = map(x - d_2, y + d_2);
+        double se = map(x + d_2, y - d_2);
+        double sw = map(x + d_2, y + d_2);
+
+        // center
+        double center = (ne + nw + se + sw) / 4;
+        map(x, y) = center + noise(x, y);
+
+        // north
+        double north = (ne + nw) / 2;
+        map(x - d_2, y) = north + noise(x - d_2, y);
+
+        // south
+        double south = (se + sw) / 2;
+        map(x + d_2, y) = south + noise(x + d_2, y);
+
+        // east
+        double east = (ne + se) / 2;
+        map(x, y - d_2) = east + noise(x, y - d_2);
+
+        // west
+        double west = (nw + sw) / 2;
+        map(x, y + d_2) = west + noise(x, y + d_2);
+      }
+    }
+  }
+
+  // each new point of the level is computed once, by the column it belongs
+  // to: the points only depend on the points of the previous level, so the
+  // columns are computed in parallel. As the noise of a point does not
+  // depend on the square, the result is the same as the legacy order.
+  static void subdivide(const counter_noise& noise, heightmap& map, size_type d) {
+    size_type d_2 = d / 2;
+    size_type count = (map.width() - 1) / d_2 + 1;
+
+    parallel_for(0, count, [&](size_type begin, size_type end) {
+      for (size_type i = begin; i < end; ++i) {
+        size_type x = i * d_2;
+
+        if (i % 2 == 0) {
+          // west and east edges
+          for (size_type y = d_2; y < map.height(); y += d) {
+            double value = (map(x, y - d_2) + map(x, y + d_2)) / 2;
+            map(x, y) = value + noise(x, y);
+          }
+
+          continue;
+        }
+
+        // centers
         for (size_type y = d_2; y < map.height(); y += d) {
-          double ne = map(x - d_2, y - d_2);
-          double nw = map(x - d_2, y + d_2);
-          double se = map(x + d_2, y - d_2);
-          double sw = map(x + d_2, y + d_2);
-
-          // center
-          double center = (ne + nw + se + sw) / 4;
-          map(x, y) = center + dist(engine);
-
-          // north
-          double north = (ne + nw) / 2;
-          map(x - d_2, y) = north + dist(engine);
-
-          // south
-          double south = (se + sw) / 2;
-          map(x + d_2, y) = south + dist(engine);
-
-          // east
-          double east = (ne + se) / 2;
-          map(x, y - d_2) = east + dist(engine);
-
-          // west
-          double west = (nw + sw) / 2;
-          map(x, y + d_2) = west + dist(engine);
+          double value = (map(x - d_2, y - d_2) + map(x - d_2, y + d_2) + map(x + d_2, y - d_2) + map(x + d_2, y + d_2)) / 4;
+          map(x, y) = value + noise(x, y);
+        }
+
+        // north and south edges
+        for (size_type y = 0; y < map.height(); y += d) {
+          double value = (map(x - d_2, y) + map(x + d_2, y)) / 2;
+          map(x, y) = value + noise(x, y);
         }
       }
+    });
+  }
+
+  // set the points of the lattice of the grid: the corners get the values,
+  // the other points get the bilinear interpolation of the corners plus
+  // some noise
+  template<typename Noise>
+  static void initialize_lattice(Noise& noise, heightmap& map, const block_grid& grid, double ne, double nw, double sw, double se) {
+    noise.set_level(grid.step);
+
+    for (size_type i = 0; i <= grid.columns; ++i) {
+      double t = static_cast<double>(i) / grid.columns;
+
+      for (size_type j = 0; j <= grid.rows; ++j) {
+        double u = static_cast<double>(j) / grid.rows;
+        size_type x = i * grid.step;
+        size_type y = j * grid.step;
+
+        double value = (1 - t) * ((1 - u) * ne + u * nw) + t * ((1 - u) * se + u * sw);
+        bool corner = (i == 0 || i == grid.columns) && (j == 0 || j == grid.rows);
 
-      d = d_2;
+        map(x, y) = corner ? value : value + noise(x, y);
+      }
     }
+  }
+
+  template<typename Noise>
+  static heightmap generate(Noise noise, grid_shape shape, size_type width, size_type height, double ne0, double nw0, double sw0, double se0) {
+    block_grid grid = compute_block_grid(shape, width, height);
+
+    size_type d = grid.step;
+    heightmap map(grid.width(), grid.height());
+
+    initialize_lattice(noise, map, grid, ne0, nw0, sw0, se0);
 
-    size_type offset_x = (size - width) / 2;
-    size_type offset_y = (size - height) / 2;
+    while (d >= 2) {
+      noise.set_level(d);
+      subdivide(noise, map, d);
+      d = d / 2;
+    }
+
+    if (map.width() == width && map.height() == height) {
+      return map;
+    }
+
+    size_type offset_x = (map.width() - width) / 2;
+    size_type offset_y = (map.height() - height) / 2;
+
+    return map.submap(offset_x, offset_y, width, height);
+  }
+
+  heightmap midpoint_displacement::operator()(random_engine& engine, size_type width, size_type height) const {
+    if (m_mode == random_mode::counter) {
+      return generate(counter_noise(engine), m_shape, width, height, m_ne, m_nw, m_sw, m_se);
+    }
 
-    return std::move(map.submap(offset_x, offset_y, width, height));
+    return generate(sequential_noise(engine), m_shape, width, height, m_ne, m_nw, m_sw, m_se);
   }
 
 }
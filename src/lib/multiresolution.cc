@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <mm/multiresolution.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <mm/thread_pool.h>
+
+namespace mm {
+
+  namespace {
+
+    typedef multiresolution::size_type size_type;
+
+    // each cell is the mean of (up to) 2x2 cells of the source
+    heightmap downsample(const heightmap& src) {
+      size_type width = (src.width() + 1) / 2;
+      size_type height = (src.height() + 1) / 2;
+      heightmap map(width, height);
+
+      parallel_for(0, width, [&](size_type b, size_type e) {
+        for (size_type x = b; x < e; ++x) {
+          size_type x1 = std::min(2 * x + 1, src.width() - 1);
+
+          for (size_type y = 0; y < height; ++y) {
+            size_type y1 = std::min(2 * y + 1, src.height() - 1);
+            map(x, y) = (src(2 * x, 2 * y) + src(x1, 2 * y) + src(2 * x, y1) + src(x1, y1)) / 4;
+          }
+        }
+      });
+
+      return map;
+    }
+
+    // add the bilinear interpolation of the difference between the
+    // computed coarse map and the original coarse map
+    void add_upsampled_changes(heightmap& map, const heightmap& computed, const heightmap& original) {
+      size_type width = map.width();
+      size_type height = map.height();
+      size_type coarse_width = computed.width();
+      size_type coarse_height = computed.height();
+
+      auto coarse = [&](size_type i, size_type n, size_type& i0, size_type& i1, double& t) {
+        double c = std::max(0.0, (i + 0.5) / 2 - 0.5);
+        i0 = std::min(static_cast<size_type>(c), n - 1);
+        i1 = std::min(i0 + 1, n - 1);
+        t = c - i0;
+      };
+
+      parallel_for(0, width, [&](size_type b, size_type e) {
+        for (size_type x = b; x < e; ++x) {
+          size_type x0, x1;
+          double u;
+          coarse(x, coarse_width, x0, x1, u);
+
+          for (size_type y = 0; y < height; ++y) {
+            size_type y0, y1;
+            double v;
+            coarse(y, coarse_height, y0, y1, v);
+
+            double d00 = computed(x0, y0) - original(x0, y0);
+            double d10 = computed(x1, y0) - original(x1, y0);
+            double d01 = computed(x0, y1) - original(x0, y1);
+            double d11 = computed(x1, y1) - original(x1, y1);
+
+            map(x, y) += (d00 * (1 - u) + d10 * u) * (1 - v) + (d01 * (1 - u) + d11 * u) * v;
+          }
+        }
+      });
+    }
+
+  }
+
+  heightmap multiresolution::operator()(const heightmap& src) const {
+    // the maps of the levels, from the original to the coarsest, without
+    // going under 2 cells
+    std::vector<heightmap> originals;
+    originals.push_back(src);
+
+    while (originals.size() < m_levels && originals.back().width() > 2 && originals.back().height() > 2) {
+      originals.push_back(downsample(originals.back()));
+    }
+
+    size_type levels = originals.size();
+
+    // level l gets 2^l / (2^levels - 1) of the iterations, and the
+    // remainder goes to the coarsest level
+    size_type total = (size_type(1) << levels) - 1;
+    std::vector<size_type> iterations(levels);
+    size_type given = 0;
+
+    for (size_type l = 0; l + 1 < levels; ++l) {
+      iterations[l] = m_iterations * (size_type(1) << l) / total;
+      given += iterations[l];
+    }
+
+    iterations[levels - 1] = m_iterations - given;
+
+    heightmap map = m_step(originals[levels - 1], levels - 1, iterations[levels - 1]);
+
+    for (size_type l = levels - 1; l > 0; --l) {
+      heightmap finer(originals[l - 1]);
+      add_upsampled_changes(finer, map, originals[l]);
+      heightmap next = m_step(finer, l - 1, iterations[l - 1]);
+      map.swap(next);
+    }
+
+    return map;
+  }
+
+}
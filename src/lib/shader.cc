@@ -36,6 +36,49 @@ namespace mm {
 
   static const vector3 light = {-1, -1, 0};
 
+  // the light factor for a normal vector
+  static double light_factor(const vector3& normal) {
+    double d = dot(light, normal);
+    d = 0.5 + 35 * d;
+
+    if (d > 1) {
+      d = 1;
+    }
+
+    if (d < 0) {
+      d = 0;
+    }
+
+    return d;
+  }
+
+  static colormap shade(const colormap& src, const heightmap& map, const heightmap& factor, double sea_level) {
+    colormap result(size_only, src);
+
+    for (colormap::size_type x = 0; x < src.width(); ++x) {
+      for (colormap::size_type y = 0; y < src.height(); ++y) {
+        if (map(x, y) < sea_level) {
+          result(x, y) = src(x, y);
+          continue;
+        }
+
+        double d = factor(x, y);
+
+        auto lo = lerp(src(x, y), {0x33, 0x11, 0x33}, 0.7);
+        auto hi = lerp(src(x, y), {0xFF, 0xFF, 0xCC}, 0.3);
+
+        if (d < 0.5) {
+          result(x, y) = lerp(lo, src(x, y), 2 * d);
+        } else {
+          result(x, y) = lerp(src(x, y), hi, 2 * d - 1);
+        }
+
+      }
+    }
+
+    return result;
+  }
+
   colormap shader::operator()(const colormap& src, const heightmap& map) const {
     assert(src.width() == map.width());
     assert(src.height() == map.height());
@@ -44,6 +87,11 @@ namespace mm {
 
     for (heightmap::size_type x = 0; x < map.width(); ++x) {
       for (heightmap::size_type y = 0; y < map.height(); ++y) {
+        // the sea is not shaded
+        if (map(x, y) < m_sea_level) {
+          continue;
+        }
+
         double xx = x;
         double yy = y;
 
@@ -108,45 +156,32 @@ namespace mm {
         }
 
         vector3 normal = unit({nx / count, ny / count, nz / count});
-        double d = dot(light, normal);
-        d = 0.5 + 35 * d;
-
-        if (d > 1) {
-          d = 1;
-        }
-
-        if (d < 0) {
-          d = 0;
-        }
-
-        factor(x, y) = d;
+        factor(x, y) = light_factor(normal);
       }
     }
 
-    colormap result(size_only, src);
-
-    for (colormap::size_type x = 0; x < src.width(); ++x) {
-      for (colormap::size_type y = 0; y < src.height(); ++y) {
-        if (map(x, y) < m_sea_level) {
-          result(x, y) = src(x, y);
-          continue;
-        }
+    return shade(src, map, factor, m_sea_level);
+  }
 
-        double d = factor(x, y);
+  colormap shader::operator()(const colormap& src, const heightmap& map, const heightmap& dx, const heightmap& dy) const {
+    assert(src.width() == map.width() && dx.width() == map.width() && dy.width() == map.width());
+    assert(src.height() == map.height() && dx.height() == map.height() && dy.height() == map.height());
 
-        auto lo = lerp(src(x, y), {0x33, 0x11, 0x33}, 0.7);
-        auto hi = lerp(src(x, y), {0xFF, 0xFF, 0xCC}, 0.3);
+    heightmap factor(size_only, map);
 
-        if (d < 0.5) {
-          result(x, y) = lerp(lo, src(x, y), 2 * d);
-        } else {
-          result(x, y) = lerp(src(x, y), hi, 2 * d - 1);
+    for (heightmap::size_type x = 0; x < map.width(); ++x) {
+      for (heightmap::size_type y = 0; y < map.height(); ++y) {
+        if (map(x, y) < m_sea_level) {
+          continue;
         }
 
+        // the normal of the surface z = h(x, y)
+        vector3 normal = unit({-dx(x, y), -dy(x, y), 1});
+        factor(x, y) = light_factor(normal);
       }
     }
 
-    return result;
+    return shade(src, map, factor, m_sea_level);
   }
 
 }
@@ -22,8 +22,15 @@
 
 namespace mm {
 
-  simplex_noise::simplex_noise(random_engine& engine)
+  simplex_noise::simplex_noise(random_engine& engine, lattice kind)
+  : m_lattice(kind)
+  , m_seed(0)
   {
+    if (m_lattice == lattice::hash) {
+      m_seed = engine();
+      return;
+    }
+
     // initialize permutation
     for (uint8_t i = 0; i < 255; ++i) {
       m_perm[i] = i;
@@ -52,8 +59,12 @@ namespace mm {
     {  1.0, -1.0 }
   };
 
-  const vector2& simplex_noise::grid(uint8_t i, uint8_t j) const {
-    uint8_t index = i + m_perm.at(j);
+  vector2 simplex_noise::grid(int64_t i, int64_t j) const {
+    if (m_lattice == lattice::hash) {
+      return lattice_gradient(lattice_hash(m_seed, i, j));
+    }
+
+    uint8_t index = static_cast<uint8_t>(i) + m_perm.at(static_cast<uint8_t>(j));
     return s_gradients[index % 8];
   }
 
@@ -75,8 +86,8 @@ namespace mm {
     double x0 = x - X0;
     double y0 = y - Y0;
 
-    uint8_t i1 = 0;
-    uint8_t j1 = 0;
+    int64_t i1 = 0;
+    int64_t j1 = 0;
 
     if (x0 > y0) {
       i1 = 1;
@@ -90,8 +101,8 @@ namespace mm {
     double x2 = x0 - 1 + 2.0 * C;
     double y2 = y0 - 1 + 2.0 * C;
 
-    uint8_t ii = static_cast<uint8_t>(i);
-    uint8_t jj = static_cast<uint8_t>(j);
+    int64_t ii = static_cast<int64_t>(i);
+    int64_t jj = static_cast<int64_t>(j);
 
     double res = 0.0;
 
@@ -119,4 +130,65 @@ namespace mm {
     return 60 * res;
   }
 
+  /*
+   * each corner adds t^4 * dot(g, d) with t = 0.5 - dot(d, d), so its
+   * derivative is t^4 * g - 8 * t^3 * dot(g, d) * d
+   */
+  static double corner(const vector2& g, double x, double y, vector2& derivatives) {
+    double t = 0.5 - x*x - y*y;
+
+    if (t <= 0) {
+      return 0.0;
+    }
+
+    double t2 = t * t;
+    double t4 = t2 * t2;
+    double value = dot(g, { x, y });
+
+    derivatives.x += t4 * g.x - 8 * t2 * t * value * x;
+    derivatives.y += t4 * g.y - 8 * t2 * t * value * y;
+
+    return t4 * value;
+  }
+
+  double simplex_noise::operator()(double x, double y, vector2& derivatives) const {
+    double s = (x + y) * K;
+    double i = std::floor(x + s);
+    double j = std::floor(y + s);
+
+    double t = (i + j) * C;
+    double x0 = x - (i - t);
+    double y0 = y - (j - t);
+
+    int64_t i1 = 0;
+    int64_t j1 = 0;
+
+    if (x0 > y0) {
+      i1 = 1;
+    } else {
+      j1 = 1;
+    }
+
+    double x1 = x0 - i1 + C;
+    double y1 = y0 - j1 + C;
+
+    double x2 = x0 - 1 + 2.0 * C;
+    double y2 = y0 - 1 + 2.0 * C;
+
+    int64_t ii = static_cast<int64_t>(i);
+    int64_t jj = static_cast<int64_t>(j);
+
+    derivatives = { 0.0, 0.0 };
+
+    double res = 0.0;
+    res += corner(grid(ii, jj), x0, y0, derivatives);
+    res += corner(grid(ii + i1, jj + j1), x1, y1, derivatives);
+    res += corner(grid(ii + 1, jj + 1), x2, y2, derivatives);
+
+    derivatives.x *= 60;
+    derivatives.y *= 60;
+
+    return 60 * res;
+  }
+
 }
@@ -15,16 +15,28 @@
  */
 #include <mm/smooth.h>
 
+#include <algorithm>
+
+#include <mm/utils.h>
+
 namespace mm {
 
-  heightmap smooth::operator()(const heightmap& src) const {
+  heightmap smooth::operator()(const heightmap& src, const binarymap& mask, size_type& iterations) const {
+    bool masked = mask.width() == src.width() && mask.height() == src.height();
+
+    // the cells outside the mask are never written and keep their value
     heightmap map(src);
-    heightmap out(size_only, src);
+    heightmap out = masked ? heightmap(src) : heightmap(size_only, src);
 
-    for (size_type k = 0; k < m_iterations; ++k) {
+    for (iterations = 0; iterations < m_iterations; ) {
+      double change = 0.0;
 
       for (heightmap::size_type x = 0; x < map.width(); ++x) {
         for (heightmap::size_type y = 0; y < map.height(); ++y) {
+          if (masked && !mask(x, y)) {
+            continue;
+          }
+
           double value = 0.0;
           size_type count = 0;
 
@@ -53,9 +65,18 @@ namespace mm {
 
           out(x, y) = value / count;
         }
+
+        if (m_tolerance > 0) {
+          change = std::max(change, max_difference(&out(x, 0), &map(x, 0), map.height()));
+        }
       }
 
       map = out;
+      ++iterations;
+
+      if (m_tolerance > 0 && change < m_tolerance) {
+        break;
+      }
     }
 
     return out;
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <mm/spectral.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include <mm/thread_pool.h>
+
+namespace mm {
+
+  typedef typename spectral::size_type size_type;
+  typedef std::complex<double> complex;
+
+  namespace {
+
+    // an inverse discrete Fourier transform of length n (without the 1/n
+    // factor): radix-2 if n is a power of two, Bluestein otherwise
+    class inverse_fft {
+    public:
+      inverse_fft(size_type n)
+      : m_n(n)
+      , m_m(1)
+      {
+        while (m_m < n) {
+          m_m *= 2;
+        }
+
+        if (m_m != n) {
+          // Bluestein: the transform is a convolution of length >= 2n - 1
+          m_m = 1;
+
+          while (m_m < 2 * n - 1) {
+            m_m *= 2;
+          }
+
+          m_chirp.resize(n);
+
+          for (size_type k = 0; k < n; ++k) {
+            // k^2 mod 2n keeps the angle precise for large k
+            size_type k2 = (k * k) % (2 * n);
+            double angle = M_PI * k2 / n;
+            m_chirp[k] = std::polar(1.0, angle);
+          }
+        }
+
+        m_twiddles.resize(m_m / 2);
+
+        for (size_type k = 0; k < m_m / 2; ++k) {
+          m_twiddles[k] = std::polar(1.0, 2 * M_PI * k / m_m);
+        }
+
+        if (m_m != n) {
+          m_kernel.assign(m_m, complex(0.0, 0.0));
+          m_kernel[0] = std::conj(m_chirp[0]);
+
+          for (size_type k = 1; k < n; ++k) {
+            m_kernel[k] = m_kernel[m_m - k] = std::conj(m_chirp[k]);
+          }
+
+          radix2(m_kernel.data(), false);
+        }
+      }
+
+      // the scratch buffer is only used by Bluestein, one per thread
+      void operator()(complex *data, std::vector<complex>& scratch) const {
+        if (m_m == m_n) {
+          radix2(data, true);
+          return;
+        }
+
+        scratch.assign(m_m, complex(0.0, 0.0));
+
+        for (size_type k = 0; k < m_n; ++k) {
+          scratch[k] = data[k] * m_chirp[k];
+        }
+
+        radix2(scratch.data(), false);
+
+        for (size_type k = 0; k < m_m; ++k) {
+          scratch[k] *= m_kernel[k];
+        }
+
+        radix2(scratch.data(), true);
+
+        double factor = 1.0 / m_m;
+
+        for (size_type k = 0; k < m_n; ++k) {
+          data[k] = scratch[k] * m_chirp[k] * factor;
+        }
+      }
+
+    private:
+      size_type m_n;
+      size_type m_m;
+      std::vector<complex> m_twiddles;
+      std::vector<complex> m_chirp;
+      std::vector<complex> m_kernel;
+
+      // in place transform of length m_m, with exp(+i...) if inverse
+      void radix2(complex *data, bool inverse) const {
+        for (size_type i = 1, j = 0; i < m_m; ++i) {
+          size_type bit = m_m >> 1;
+
+          for (; j & bit; bit >>= 1) {
+            j ^= bit;
+          }
+
+          j ^= bit;
+
+          if (i < j) {
+            std::swap(data[i], data[j]);
+          }
+        }
+
+        for (size_type len = 2; len <= m_m; len *= 2) {
+          size_type half = len / 2;
+          size_type stride = m_m / len;
+
+          for (size_type i = 0; i < m_m; i += len) {
+            for (size_type k = 0; k < half; ++k) {
+              complex w = inverse ? m_twiddles[k * stride] : std::conj(m_twiddles[k * stride]);
+              complex u = data[i + k];
+              complex v = data[i + k + half] * w;
+              data[i + k] = u + v;
+              data[i + k + half] = u - v;
+            }
+          }
+        }
+      }
+    };
+
+    // the signed frequency of the index k in a transform of length n, in
+    // cycles per pixel
+    double frequency(size_type k, size_type n) {
+      if (2 * k <= n) {
+        return static_cast<double>(k) / n;
+      }
+
+      return (static_cast<double>(k) - static_cast<double>(n)) / n;
+    }
+
+  }
+
+  heightmap spectral::operator()(random_engine& engine, size_type width, size_type height) const {
+    // the map is real, so the spectrum is hermitian: Z(-fx, -fy) is the
+    // conjugate of Z(fx, fy). Only the columns x <= width / 2 are stored,
+    // column-major like the heightmap.
+    size_type columns = width / 2 + 1;
+    std::vector<complex> spectrum(columns * height);
+
+    // the random values of a frequency only depend on its position, so the
+    // columns are computed in parallel and the map does not depend on the
+    // number of threads
+    counter_random random(engine());
+
+    std::vector<double> fy2(height);
+
+    for (size_type y = 0; y < height; ++y) {
+      double fy = frequency(y, height);
+      fy2[y] = fy * fy;
+    }
+
+    parallel_for(0, columns, [&](size_type begin, size_type end) {
+      // the amplitude of y and height - y are the same
+      std::vector<double> amplitudes(height / 2 + 1);
+
+      for (size_type x = begin; x < end; ++x) {
+        double fx = frequency(x, width);
+        double fx2 = fx * fx;
+
+        for (size_type y = 0; y < amplitudes.size(); ++y) {
+          double f2 = fx2 + fy2[y];
+          // the power is 1/f^beta, so the amplitude is 1/f^(beta/2)
+          amplitudes[y] = (f2 == 0.0) ? 0.0 : std::pow(f2, -m_beta / 4);
+        }
+
+        complex *column = spectrum.data() + x * height;
+
+        for (size_type y = 0; y < height; ++y) {
+          double amplitude = amplitudes[2 * y <= height ? y : height - y];
+
+          // a complex gaussian value (Box-Muller), from two 32-bit uniform
+          // values
+          uint64_t bits = random(0, x, y);
+          double u1 = static_cast<double>(bits >> 32) * 0x1.0p-32;
+          double u2 = static_cast<double>(bits & 0xFFFFFFFF) * 0x1.0p-32;
+
+          double modulus = amplitude * std::sqrt(-2.0 * std::log1p(-u1));
+          column[y] = std::polar(modulus, 2 * M_PI * u2);
+        }
+
+        // the columns fx = 0 and fx = -fx (width / 2) are their own mirror
+        if (x == 0 || 2 * x == width) {
+          column[0] = column[0].real();
+
+          for (size_type y = 1; 2 * y <= height; ++y) {
+            if (2 * y == height) {
+              column[y] = column[y].real();
+            } else {
+              column[height - y] = std::conj(column[y]);
+            }
+          }
+        }
+      }
+    });
+
+    // the columns are contiguous, they are transformed in place
+    inverse_fft fft_y(height);
+
+    parallel_for(0, columns, [&](size_type begin, size_type end) {
+      std::vector<complex> scratch;
+
+      for (size_type x = begin; x < end; ++x) {
+        fft_y(spectrum.data() + x * height, scratch);
+      }
+    });
+
+    // then the rows, the missing columns being the conjugate of the stored
+    // ones. The result of a row is real, so two rows are transformed at
+    // once, as the real and the imaginary part. The rows are gathered by
+    // blocks, so that the reads of a column are contiguous.
+    constexpr size_type BLOCK = 8;
+
+    inverse_fft fft_x(width);
+    heightmap map(width, height);
+
+    parallel_for(0, (height + BLOCK - 1) / BLOCK, [&](size_type begin, size_type end) {
+      std::vector<complex> rows(BLOCK * columns);
+      std::vector<double> values(BLOCK * width);
+      std::vector<complex> line(width);
+      std::vector<complex> scratch;
+
+      auto row = [&](size_type k, size_type x) {
+        return (x < columns) ? rows[k * columns + x] : std::conj(rows[k * columns + width - x]);
+      };
+
+      for (size_type b = begin; b < end; ++b) {
+        size_type y0 = b * BLOCK;
+        size_type count = std::min(BLOCK, height - y0);
+
+        for (size_type x = 0; x < columns; ++x) {
+          for (size_type k = 0; k < count; ++k) {
+            rows[k * columns + x] = spectrum[x * height + y0 + k];
+          }
+        }
+
+        for (size_type k = 0; k < count; k += 2) {
+          bool pair = (k + 1 < count);
+
+          for (size_type x = 0; x < width; ++x) {
+            complex a = row(k, x);
+            complex c = pair ? row(k + 1, x) : complex(0.0, 0.0);
+            line[x] = complex(a.real() - c.imag(), a.imag() + c.real());
+          }
+
+          fft_x(line.data(), scratch);
+
+          for (size_type x = 0; x < width; ++x) {
+            values[k * width + x] = line[x].real();
+
+            if (pair) {
+              values[(k + 1) * width + x] = line[x].imag();
+            }
+          }
+        }
+
+        for (size_type x = 0; x < width; ++x) {
+          for (size_type k = 0; k < count; ++k) {
+            map(x, y0 + k) = values[k * width + x];
+          }
+        }
+      }
+    });
+
+    return map;
+  }
+
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <mm/stream_power_erosion.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <mm/thread_pool.h>
+
+namespace mm {
+
+  /*
+   * The cells are numbered i = x * height + y, like in the map. The
+   * receiver of a cell is its steepest lower neighbour, or itself for the
+   * cells of the border that are the base level. The receivers are
+   * computed on a copy of the map where the depressions are filled with a
+   * tiny slope (priority flood), so that every cell drains to the border.
+   */
+
+  namespace {
+
+    typedef stream_power_erosion::size_type size_type;
+
+    struct neighbour {
+      int dx;
+      int dy;
+      double distance;
+    };
+
+    const neighbour neighbours[8] = {
+      { -1, -1, M_SQRT2 }, { -1,  0, 1.0 }, { -1,  1, M_SQRT2 },
+      {  0, -1, 1.0 },                      {  0,  1, 1.0 },
+      {  1, -1, M_SQRT2 }, {  1,  0, 1.0 }, {  1,  1, M_SQRT2 },
+    };
+
+    bool is_border(size_type x, size_type y, size_type width, size_type height) {
+      return x == 0 || y == 0 || x == width - 1 || y == height - 1;
+    }
+
+    // the cells are processed from the lowest, starting from the border,
+    // and the cells that are raised (in a depression) are processed first
+    // in a simple queue (Barnes et al., priority flood + epsilon)
+    void fill_depressions(const std::vector<double>& altitudes, size_type width, size_type height, std::vector<double>& filled) {
+      typedef std::pair<double, size_type> entry;
+      std::priority_queue<entry, std::vector<entry>, std::greater<entry>> open;
+      std::queue<size_type> pit;
+      std::vector<bool> closed(altitudes.size(), false);
+
+      filled = altitudes;
+
+      for (size_type x = 0; x < width; ++x) {
+        for (size_type y = 0; y < height; ++y) {
+          if (is_border(x, y, width, height)) {
+            size_type i = x * height + y;
+            closed[i] = true;
+            open.push({ filled[i], i });
+          }
+        }
+      }
+
+      while (!open.empty() || !pit.empty()) {
+        size_type i;
+
+        if (!pit.empty()) {
+          i = pit.front();
+          pit.pop();
+        } else {
+          i = open.top().second;
+          open.pop();
+        }
+
+        size_type x = i / height;
+        size_type y = i % height;
+        double above = std::nextafter(filled[i], HUGE_VAL);
+
+        for (auto& n : neighbours) {
+          size_type nx = x + n.dx;
+          size_type ny = y + n.dy;
+
+          if (nx >= width || ny >= height) {
+            continue;
+          }
+
+          size_type j = nx * height + ny;
+
+          if (closed[j]) {
+            continue;
+          }
+
+          closed[j] = true;
+
+          if (filled[j] <= above) {
+            filled[j] = above;
+            pit.push(j);
+          } else {
+            open.push({ filled[j], j });
+          }
+        }
+      }
+    }
+
+    void compute_receivers(const std::vector<double>& filled, size_type width, size_type height, std::vector<size_type>& receivers, std::vector<double>& distances) {
+      parallel_for(0, width, [&](size_type b, size_type e) {
+        for (size_type x = b; x < e; ++x) {
+          for (size_type y = 0; y < height; ++y) {
+            size_type i = x * height + y;
+            receivers[i] = i;
+            distances[i] = 1.0;
+
+            if (is_border(x, y, width, height)) {
+              continue;
+            }
+
+            double slope_max = 0.0;
+
+            for (auto& n : neighbours) {
+              size_type j = (x + n.dx) * height + (y + n.dy);
+              double slope = (filled[i] - filled[j]) / n.distance;
+
+              if (slope > slope_max) {
+                slope_max = slope;
+                receivers[i] = j;
+                distances[i] = n.distance;
+              }
+            }
+          }
+        }
+      });
+    }
+
+    // the cells ordered so that the receiver of a cell comes before the cell
+    void compute_stack(const std::vector<size_type>& receivers, std::vector<size_type>& offsets, std::vector<size_type>& donors, std::vector<size_type>& stack) {
+      size_type size = receivers.size();
+
+      std::fill(offsets.begin(), offsets.end(), 0);
+
+      for (size_type i = 0; i < size; ++i) {
+        if (receivers[i] != i) {
+          ++offsets[receivers[i] + 1];
+        }
+      }
+
+      for (size_type i = 0; i < size; ++i) {
+        offsets[i + 1] += offsets[i];
+      }
+
+      std::vector<size_type> next(offsets.begin(), offsets.end() - 1);
+
+      for (size_type i = 0; i < size; ++i) {
+        if (receivers[i] != i) {
+          donors[next[receivers[i]]++] = i;
+        }
+      }
+
+      size_type end = 0;
+
+      for (size_type i = 0; i < size; ++i) {
+        if (receivers[i] == i) {
+          stack[end++] = i;
+        }
+      }
+
+      for (size_type k = 0; k < end; ++k) {
+        size_type i = stack[k];
+
+        for (size_type d = offsets[i]; d < offsets[i + 1]; ++d) {
+          stack[end++] = donors[d];
+        }
+      }
+    }
+
+  }
+
+  heightmap stream_power_erosion::operator()(const heightmap& src) const {
+    heightmap map(src);
+
+    size_type width = map.width();
+    size_type height = map.height();
+
+    if (width < 3 || height < 3) {
+      return map;
+    }
+
+    size_type size = width * height;
+
+    std::vector<double> altitudes(size);
+
+    for (size_type x = 0; x < width; ++x) {
+      for (size_type y = 0; y < height; ++y) {
+        altitudes[x * height + y] = map(x, y);
+      }
+    }
+
+    std::vector<double> filled(size);
+    std::vector<size_type> receivers(size);
+    std::vector<double> distances(size);
+    std::vector<size_type> offsets(size + 1);
+    std::vector<size_type> donors(size);
+    std::vector<size_type> stack(size);
+    std::vector<double> areas(size);
+
+    for (size_type k = 0; k < m_iterations; ++k) {
+      fill_depressions(altitudes, width, height, filled);
+      compute_receivers(filled, width, height, receivers, distances);
+      compute_stack(receivers, offsets, donors, stack);
+
+      // drainage area, from the top of the hills to the border
+      std::fill(areas.begin(), areas.end(), 1.0);
+
+      for (size_type s = size; s > 0; --s) {
+        size_type i = stack[s - 1];
+
+        if (receivers[i] != i) {
+          areas[receivers[i]] += areas[i];
+        }
+      }
+
+      // implicit solve, from the border to the top of the hills, the
+      // receiver of a cell has already its new altitude
+      for (size_type s = 0; s < size; ++s) {
+        size_type i = stack[s];
+        size_type r = receivers[i];
+
+        if (r == i) {
+          continue;
+        }
+
+        double factor = m_erosion * m_time_step * std::pow(areas[i], m_area_exponent) / distances[i];
+        double uplifted = altitudes[i] + m_uplift * m_time_step;
+
+        // in a depression, the receiver on the filled map can be higher than
+        // the cell, the erosion must not raise it
+        altitudes[i] = std::min((uplifted + factor * altitudes[r]) / (1 + factor), uplifted);
+      }
+    }
+
+    for (size_type x = 0; x < width; ++x) {
+      for (size_type y = 0; y < height; ++y) {
+        map(x, y) = altitudes[x * height + y];
+      }
+    }
+
+    return map;
+  }
+
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <mm/temporal_blocking.h>
+
+#include <algorithm>
+
+#include <mm/thread_pool.h>
+
+namespace mm {
+
+  heightmap temporal_blocking::operator()(const heightmap& src) const {
+    heightmap map(src);
+    heightmap next(size_only, src);
+
+    size_type width = map.width();
+    size_type height = map.height();
+
+    if (width == 0 || height == 0 || m_iterations == 0) {
+      return m_step(map, m_iterations);
+    }
+
+    size_type depth = std::max(m_depth, size_type(1));
+    size_type columns = (width + tile_size - 1) / tile_size;
+    size_type rows = (height + tile_size - 1) / tile_size;
+
+    for (size_type done = 0; done < m_iterations; ) {
+      size_type iterations = std::min(depth, m_iterations - done);
+      size_type halo = iterations * m_reach;
+
+      parallel_for(0, columns * rows, [&](size_type b, size_type e) {
+        for (size_type t = b; t < e; ++t) {
+          // the tile, and the tile with its halo, inside the map
+          size_type x0 = (t / rows) * width / columns;
+          size_type x1 = (t / rows + 1) * width / columns;
+          size_type y0 = (t % rows) * height / rows;
+          size_type y1 = (t % rows + 1) * height / rows;
+
+          size_type hx0 = x0 >= halo ? x0 - halo : 0;
+          size_type hx1 = std::min(x1 + halo, width);
+          size_type hy0 = y0 >= halo ? y0 - halo : 0;
+          size_type hy1 = std::min(y1 + halo, height);
+
+          heightmap tile(hx1 - hx0, hy1 - hy0);
+
+          for (size_type x = hx0; x < hx1; ++x) {
+            std::copy_n(&map(x, hy0), hy1 - hy0, &tile(x - hx0, 0));
+          }
+
+          heightmap result = m_step(tile, iterations);
+
+          for (size_type x = x0; x < x1; ++x) {
+            std::copy_n(&result(x - hx0, y0 - hy0), y1 - y0, &next(x, y0));
+          }
+        }
+      });
+
+      map.swap(next);
+      done += iterations;
+    }
+
+    return map;
+  }
+
+}
@@ -15,60 +15,236 @@
  */
 #include <mm/thermal_erosion.h>
 
+#include <algorithm>
+#include <vector>
+
+#include <mm/active_set.h>
+#include <mm/thread_pool.h>
+#include <mm/utils.h>
+
 namespace mm {
 
-  heightmap thermal_erosion::operator()(const heightmap& src) const {
-    double d[3][3];
+  /*
+   * Each cell gives material to its lower neighbours. Instead of scattering
+   * the material from each cell, each cell gathers the material from its
+   * higher neighbours, from the previous map to the next map (double
+   * buffering), so that the columns can be computed in parallel. The
+   * material given by the cells of a column is computed once in a column
+   * buffer. The neighbours are gathered in the order where they were
+   * scattered, so the result is the same for any number of threads.
+   *
+   * Only the active rows are computed: the cells whose neighbours at
+   * distance 2 did not change in the previous iteration do not change. The
+   * blocks of rows without a cell of the mask are never active.
+   *
+   * With a tolerance, the largest change of each column is computed after
+   * the column, while it is in the cache.
+   */
 
-    heightmap map(src);
-    heightmap material(size_only, src);
+  namespace {
 
-    for (size_type k = 0; k < m_iterations; ++k) {
-      // initialize material map
-      for (size_type x = 1; x < material.width() - 1; ++x) {
-        for (size_type y = 1; y < material.height() - 1; ++y) {
-          material(x, y) = 0.0;
-        }
+    typedef thermal_erosion::size_type size_type;
+
+    // the neighbour (x + i, y + j) of a cell is k = (1 + i) * 3 + (1 + j)
+    constexpr size_type neighbours = 9;
+
+    // flow[k * height + y] is the material given by cell y to neighbour k,
+    // and is zero if the cell gives nothing to this neighbour, the border
+    // rows give nothing
+    struct source_column {
+      std::vector<double> flow;
+    };
+
+    // computes the sources of the rows [y_begin, y_end) of column x, the
+    // cells outside the mask (if any) give nothing
+    void compute_sources(const heightmap& map, const bool *mask, size_type x, size_type y_begin, size_type y_end, double talus, double fraction, source_column& col) {
+      size_type height = map.height();
+
+      y_begin = std::max(y_begin, size_type(1));
+      y_end = std::min(y_end, height - 1);
+
+      for (size_type k = 0; k < neighbours; ++k) {
+        std::fill(col.flow.begin() + k * height + y_begin, col.flow.begin() + k * height + y_end, 0.0);
       }
 
-      // compute material map
-      for (size_type x = 1; x < src.width() - 1; ++x) {
-        for (size_type y = 1; y < src.height() - 1; ++y) {
-          double d_total = 0.0;
-          double d_max = 0.0;
+      const double *columns[3] = { &map(x - 1, 0), &map(x, 0), &map(x + 1, 0) };
 
-          for (int i = -1; i <= 1; ++i) {
-            for (int j = -1; j <= 1; ++j) {
-              double diff = map(x, y) - map(x+i, y+j);
-              d[1+i][1+j] = diff;
+      for (size_type y = y_begin; y < y_end; ++y) {
+        if (mask != nullptr && !mask[y]) {
+          continue;
+        }
 
-              if (diff > m_talus) {
-                d_total += diff;
+        double here = columns[1][y];
+        double d[neighbours];
+        double d_total = 0.0;
+        double d_max = 0.0;
 
-                if (diff > d_max) {
-                  d_max = diff;
-                }
-              }
+        for (size_type k = 0; k < neighbours; ++k) {
+          double diff = here - columns[k / 3][y + k % 3 - 1];
+          d[k] = diff;
+
+          if (diff > talus) {
+            d_total += diff;
+
+            if (diff > d_max) {
+              d_max = diff;
             }
           }
+        }
 
-          for (int i = -1; i <= 1; ++i) {
-            for (int j = -1; j <= 1; ++j) {
-              double diff = d[1+i][1+j];
+        for (size_type k = 0; k < neighbours; ++k) {
+          if (d[k] > talus) {
+            col.flow[k * height + y] = fraction * (d_max - talus) * (d[k] / d_total);
+          }
+        }
+      }
+    }
 
-              if (diff > m_talus) {
-                material(x+i, y+j) += m_fraction * (d_max - m_talus) * (diff / d_total);
-              }
-            }
+    /*
+     * The gathered sum does not skip the neighbours that give nothing like
+     * the original kernel, but adding +0.0 instead gives the same result as
+     * the sum starts from +0.0 and can not become -0.0.
+     */
+
+    // computes the next rows [y_begin, y_end) of column x
+    void gather(const heightmap& map, const source_column *cols[3], size_type x, size_type y_begin, size_type y_end, std::vector<double>& material, heightmap& next) {
+      size_type height = map.height();
+
+      if (y_begin == 0) {
+        next(x, 0) = map(x, 0);
+      }
+
+      if (y_end == height) {
+        next(x, height - 1) = map(x, height - 1);
+      }
+
+      y_begin = std::max(y_begin, size_type(1));
+      y_end = std::min(y_end, height - 1);
+
+      std::fill(material.begin() + y_begin, material.begin() + y_end, 0.0);
+
+      for (size_type i = 0; i < 3; ++i) {
+        for (size_type j = 0; j < 3; ++j) {
+          // the direction from the source to the cell
+          size_type k = (2 - i) * 3 + (2 - j);
+          const double *flow = cols[i]->flow.data() + k * height + j - 1;
+
+          for (size_type y = y_begin; y < y_end; ++y) {
+            material[y] += flow[y];
           }
         }
       }
 
-      // add material map to the map
-      for (size_type x = 1; x <= map.width() - 2; ++x) {
-        for (size_type y = 1; y <= map.height() - 2; ++y) {
-          map(x, y) += material(x, y);
+      for (size_type y = y_begin; y < y_end; ++y) {
+        next(x, y) = map(x, y) + material[y];
+      }
+    }
+
+  }
+
+  heightmap thermal_erosion::operator()(const heightmap& src, const binarymap& mask, size_type& iterations) const {
+    heightmap map(src);
+    heightmap next(src);
+
+    size_type width = map.width();
+    size_type height = map.height();
+
+    iterations = 0;
+
+    if (width < 3 || height < 3) {
+      return map;
+    }
+
+    auto interior = [width](size_type x) {
+      return x >= 1 && x + 1 < width;
+    };
+
+    bool masked = mask.width() == width && mask.height() == height;
+
+    auto mask_of = [&](size_type x) {
+      return masked ? &mask(x, 0) : nullptr;
+    };
+
+    std::vector<double> changes(width, 0.0);
+    active_set active(width, height, mask);
+
+    while (iterations < m_iterations) {
+      parallel_for(0, width, [&](size_type b, size_type e) {
+        // the sources of the columns x - 1, x and x + 1, and no source for
+        // the border columns
+        source_column sources[3];
+        source_column none = { std::vector<double>(height * neighbours, 0.0) };
+        std::vector<double> material(height);
+
+        for (auto& col : sources) {
+          col.flow.resize(height * neighbours);
         }
+
+        // the rows that give material to the active rows, one row around
+        // the source runs
+        auto sources_of = [&](size_type x) {
+          if (!interior(x) || !active.is_source(x)) {
+            return;
+          }
+
+          active.for_each_source_run(x, [&](size_type y_begin, size_type y_end) {
+            compute_sources(map, mask_of(x), x, (y_begin >= 1 ? y_begin - 1 : 0), y_end + 1, m_talus, m_fraction, sources[x % 3]);
+          });
+        };
+
+        for (size_type x = (b >= 1 ? b - 1 : 0); x <= b; ++x) {
+          sources_of(x);
+        }
+
+        for (size_type x = b; x < e; ++x) {
+          sources_of(x + 1);
+          changes[x] = 0.0;
+
+          if (!active.is_active(x)) {
+            continue;
+          }
+
+          if (!interior(x)) {
+            for (size_type y = 0; y < height; ++y) {
+              next(x, y) = map(x, y);
+            }
+
+            continue;
+          }
+
+          const source_column *cols[3] = {
+            interior(x - 1) ? &sources[(x - 1) % 3] : &none,
+            &sources[x % 3],
+            interior(x + 1) ? &sources[(x + 1) % 3] : &none
+          };
+
+          active.for_each_active_run(x, [&](size_type y_begin, size_type y_end) {
+            gather(map, cols, x, y_begin, y_end, material, next);
+
+            // the cells outside the mask receive nothing
+            if (masked) {
+              for (size_type y = y_begin; y < y_end; ++y) {
+                if (!mask(x, y)) {
+                  next(x, y) = map(x, y);
+                }
+              }
+            }
+
+            active.compare(x, y_begin, y_end, &map(x, 0), &next(x, 0));
+
+            if (m_tolerance > 0) {
+              changes[x] = std::max(changes[x], max_difference(&next(x, y_begin), &map(x, y_begin), y_end - y_begin));
+            }
+          });
+        }
+      });
+
+      active.update();
+      map.swap(next);
+      ++iterations;
+
+      if (m_tolerance > 0 && *std::max_element(changes.begin(), changes.end()) < m_tolerance) {
+        break;
       }
     }
 
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <mm/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace mm {
+
+  // set in the threads that run a part of a parallel_for
+  static thread_local bool in_parallel_for = false;
+
+  struct thread_pool::job {
+    const range_function *func;
+    size_type begin;
+    size_type end;
+    size_type grain;
+    size_type chunks;
+    std::atomic<size_type> next;
+
+    // protected by the mutex of the pool
+    size_type users;
+    std::exception_ptr error;
+  };
+
+  thread_pool::thread_pool(size_type threads)
+  : m_stop(false)
+  , m_generation(0)
+  , m_job(nullptr)
+  {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_type i = 1; i < threads; ++i) {
+      m_workers.emplace_back(&thread_pool::work, this);
+    }
+  }
+
+  thread_pool::~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+
+    m_start.notify_all();
+
+    for (auto& worker : m_workers) {
+      worker.join();
+    }
+  }
+
+  void thread_pool::parallel_for(size_type begin, size_type end, const range_function& func) {
+    if (begin >= end) {
+      return;
+    }
+
+    if (m_workers.empty() || in_parallel_for || end - begin == 1) {
+      func(begin, end);
+      return;
+    }
+
+    std::lock_guard<std::mutex> call_lock(m_call_mutex);
+
+    // a few chunks per thread, so that uneven chunks are balanced
+    job current;
+    current.func = &func;
+    current.begin = begin;
+    current.end = end;
+    current.grain = std::max<size_type>(1, (end - begin) / (4 * size()));
+    current.chunks = (end - begin + current.grain - 1) / current.grain;
+    current.next = 0;
+    current.users = 1;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_job = &current;
+      ++m_generation;
+    }
+
+    m_start.notify_all();
+
+    run(current);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&current]() { return current.users == 0; });
+    m_job = nullptr;
+    lock.unlock();
+
+    if (current.error) {
+      std::rethrow_exception(current.error);
+    }
+  }
+
+  void thread_pool::work() {
+    uint64_t generation = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;) {
+      m_start.wait(lock, [this, generation]() { return m_stop || (m_job != nullptr && m_generation != generation); });
+
+      if (m_stop) {
+        return;
+      }
+
+      generation = m_generation;
+      job& current = *m_job;
+      current.users++;
+
+      lock.unlock();
+      run(current);
+      lock.lock();
+    }
+  }
+
+  // runs chunks until there are no more, the thread must be a user of the job
+  void thread_pool::run(job& current) {
+    std::exception_ptr error;
+
+    in_parallel_for = true;
+
+    for (;;) {
+      size_type chunk = current.next.fetch_add(1);
+
+      if (chunk >= current.chunks) {
+        break;
+      }
+
+      size_type b = current.begin + chunk * current.grain;
+      size_type e = std::min(b + current.grain, current.end);
+
+      try {
+        (*current.func)(b, e);
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+
+    in_parallel_for = false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (error) {
+      current.error = error;
+    }
+
+    current.users--;
+
+    if (current.users == 0) {
+      m_done.notify_all();
+    }
+  }
+
+  static std::mutex default_mutex;
+  static std::unique_ptr<thread_pool> default_pool;
+
+  thread_pool& default_thread_pool() {
+    std::lock_guard<std::mutex> lock(default_mutex);
+
+    if (!default_pool) {
+      default_pool.reset(new thread_pool);
+    }
+
+    return *default_pool;
+  }
+
+  void set_thread_count(thread_pool::size_type threads) {
+    std::lock_guard<std::mutex> lock(default_mutex);
+    default_pool.reset(new thread_pool(threads));
+  }
+
+}
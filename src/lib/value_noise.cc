@@ -23,9 +23,16 @@
 namespace mm {
 
 
-  value_noise::value_noise(random_engine& engine, std::function<double(double)> curve)
+  value_noise::value_noise(random_engine& engine, std::function<double(double)> curve, lattice kind)
   : m_curve(curve)
+  , m_lattice(kind)
+  , m_seed(0)
   {
+    if (m_lattice == lattice::hash) {
+      m_seed = engine();
+      return;
+    }
+
     // generate values
     std::uniform_real_distribution<double> dist_value(0.0, 1.0);
     for (auto& value : m_values) {
@@ -50,19 +57,30 @@ namespace mm {
 
 
 
+  double value_noise::value(int64_t i, int64_t j) const {
+    if (m_lattice == lattice::hash) {
+      return lattice_value(lattice_hash(m_seed, i, j));
+    }
+
+    return grid(static_cast<uint8_t>(i), static_cast<uint8_t>(j));
+  }
+
   double value_noise::operator()(double x, double y) const {
-    uint8_t qx = static_cast<uint8_t>(std::fmod(x, 256));
-    double rx = std::fmod(x, 1);
-    assert(rx >= 0.0 && rx <= 1.0);
+    double fx = std::floor(x);
+    double rx = x - fx;
+    assert(rx >= 0.0 && rx < 1.0);
+
+    double fy = std::floor(y);
+    double ry = y - fy;
+    assert(ry >= 0.0 && ry < 1.0);
 
-    uint8_t qy = static_cast<uint8_t>(std::fmod(y, 256));
-    double ry = std::fmod(y, 1);
-    assert(ry >= 0.0 && ry <= 1.0);
+    int64_t qx = static_cast<int64_t>(fx);
+    int64_t qy = static_cast<int64_t>(fy);
 
-    double nw = grid(qx    , qy    );
-    double ne = grid(qx + 1, qy    );
-    double sw = grid(qx    , qy + 1);
-    double se = grid(qx + 1, qy + 1);
+    double nw = value(qx    , qy    );
+    double ne = value(qx + 1, qy    );
+    double sw = value(qx    , qy + 1);
+    double se = value(qx + 1, qy + 1);
 
     double n = lerp(nw, ne, m_curve(rx));
     double s = lerp(sw, se, m_curve(rx));
@@ -70,4 +88,34 @@ namespace mm {
     return lerp(n, s, m_curve(ry));
   }
 
+  void value_noise::line(double x, const double *y, std::size_t count, double *values) const {
+    double fx = std::floor(x);
+    double rx = x - fx;
+    assert(rx >= 0.0 && rx < 1.0);
+
+    int64_t qx = static_cast<int64_t>(fx);
+    double cx = m_curve(rx);
+
+    // the interpolated values on the two sides of the current cell
+    double cell = 0.0;
+    double n = 0.0, s = 0.0;
+
+    for (std::size_t i = 0; i < count; ++i) {
+      double fy = std::floor(y[i]);
+
+      if (i == 0 || fy != cell) {
+        cell = fy;
+
+        int64_t qy = static_cast<int64_t>(fy);
+        n = lerp(value(qx, qy    ), value(qx + 1, qy    ), cx);
+        s = lerp(value(qx, qy + 1), value(qx + 1, qy + 1), cx);
+      }
+
+      double ry = y[i] - fy;
+      assert(ry >= 0.0 && ry < 1.0);
+
+      values[i] = lerp(n, s, m_curve(ry));
+    }
+  }
+
 }